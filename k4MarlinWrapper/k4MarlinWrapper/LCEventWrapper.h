@@ -24,6 +24,8 @@
 #ifndef K4MARLINWRAPPER_LCEVENTWRAPPER_H
 #define K4MARLINWRAPPER_LCEVENTWRAPPER_H
 
+#include <chrono>
+
 #include <EVENT/LCEvent.h>
 
 #include <GaudiKernel/DataObject.h>
@@ -42,9 +44,18 @@ public:
 
   EVENT::LCEvent* getEvent() const { return m_event; }
 
+  // When the event was put in the event store, for the event time budget of the processors
+  std::chrono::steady_clock::time_point created() const { return m_created; }
+
+  // Set when a processor threw SkipEventException or went over the time budget, the processors after it skip the event
+  void skip() { m_skipped = true; }
+  bool skipped() const { return m_skipped; }
+
 private:
   EVENT::LCEvent* m_event = nullptr;
   bool m_delete_event = false;
+  bool m_skipped = false;
+  std::chrono::steady_clock::time_point m_created = std::chrono::steady_clock::now();
 };
 
 #endif
\ No newline at end of file
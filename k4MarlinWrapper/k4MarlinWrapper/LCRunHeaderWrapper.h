@@ -0,0 +1,51 @@
+/**
+ *   Copyright 2019 CERN
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ *
+ *   In applying this licence, CERN does not waive the privileges and immunities
+ *   granted to it by virtue of its status as an Intergovernmental Organization
+ *   or submit itself to any jurisdiction.
+ *
+ */
+
+#ifndef K4MARLINWRAPPER_LCRUNHEADERWRAPPER_H
+#define K4MARLINWRAPPER_LCRUNHEADERWRAPPER_H
+
+#include <memory>
+#include <utility>
+
+#include <EVENT/LCRunHeader.h>
+
+#include <GaudiKernel/DataObject.h>
+
+#include "k4MarlinWrapper/util/RunCache.h"
+
+// Run header of the current event. The header and the run cache are shared by all
+// events of the run, the wrapper in the event store only lives as long as the event.
+class LCRunHeaderWrapper : public DataObject {
+public:
+  static constexpr const char* Location = "/Event/LCRunHeader";
+
+  LCRunHeaderWrapper(std::shared_ptr<EVENT::LCRunHeader> header, std::shared_ptr<k4MW::util::RunCache> cache)
+      : m_header(std::move(header)), m_cache(std::move(cache)) {}
+
+  EVENT::LCRunHeader*   getRunHeader() const { return m_header.get(); }
+  k4MW::util::RunCache& runCache() const { return *m_cache; }
+
+private:
+  std::shared_ptr<EVENT::LCRunHeader>   m_header;
+  std::shared_ptr<k4MW::util::RunCache> m_cache;
+};
+
+#endif
@@ -26,17 +26,52 @@
 
 /***
  * LCEventAlgo: place the LCEvent from lcio file in the Gaudi Datastore for later retrieval by wrapped Marlin Processors
+ *
+ * With EventsInFlight > 0 the reading and decompression of the input runs as a separate pipeline stage
+ * on its own thread, decoding up to EventsInFlight owned events ahead and handing them to the event loop
+ * through a lock-free single producer, single consumer queue.
+ *
+ * Collections and DropCollections restrict which collections are decoded from the input.
+ *
+ * SkipEvents, EventList and EventListFile select the events to process. They switch the reader to LCIO
+ * direct access, so reaching an event does not require decoding the events before it.
+ *
+ * With NumberOfProcesses > 1 the job forks into worker processes once all algorithms are initialized, so the
+ * loaded libraries and initialized processors are shared copy-on-write. The workers claim chunks of ChunkSize
+ * events from a counter in shared memory until the input is exhausted.
+ *
+ * With WorkQueue, independent jobs on the same or different nodes claim chunks of ChunkSize events from a counter
+ * file in a shared directory, so faster jobs keep processing until the whole input is done.
+ *
+ * ShardIndex and ShardCount, or SkipEvents and NumberOfEvents, select a contiguous range of the input for jobs split
+ * over a batch farm. Output files of processors writing one file per job are suffixed with the shard.
+ *
+ * The algorithm reads one event ahead and stops the event loop after the last event of the input.
  */
 
+#include <chrono>
 #include <iostream>
+#include <limits>
 #include <memory>
+#include <optional>
+#include <set>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <sys/types.h>
 
 #include <GaudiAlg/GaudiAlgorithm.h>
 
 #include <EVENT/LCIO.h>
-#include <IOIMPL/LCFactory.h>
+#include <MT/LCReader.h>
 
 #include "k4MarlinWrapper/LCEventWrapper.h"
+#include "k4MarlinWrapper/LCRunHeaderWrapper.h"
+#include "k4MarlinWrapper/util/SPSCQueue.h"
+#include "k4MarlinWrapper/util/ChunkCounter.h"
+#include "k4MarlinWrapper/util/MetricsExporter.h"
 
 
 class LcioEvent : public GaudiAlgorithm {
@@ -44,11 +79,133 @@ public:
   explicit LcioEvent(const std::string& name, ISvcLocator* pSL);
   virtual ~LcioEvent() = default;
   virtual StatusCode initialize() override final;
+  virtual StatusCode start() override final;
   virtual StatusCode execute() override final;
+  virtual StatusCode finalize() override final;
 
 private:
+  /// An event read from the input, last is set for the final event of this process
+  struct QueuedEvent {
+    std::unique_ptr<EVENT::LCEvent> event;
+    bool                            last = false;
+    /// Chunk the event was claimed in, when the events are split into chunks
+    std::size_t chunk = 0;
+  };
+
+  /// Restrict the events to read to the shard, NumberOfEvents and, with workers or a work queue, EvtMax
+  StatusCode selectEventRange();
+
+  /// Fork the worker processes, which continue from start() with the initialized job
+  StatusCode forkWorkers();
+
+  /// Index of the next event to read for this process, false when no events are left
+  bool claimNextIndex(std::size_t& index);
+
+  /// Take the next chunk of events from the counter shared by the worker processes
+  void claimChunk();
+
+  /// Record in the work queue that all events of a chunk went through the event loop
+  void completeChunk(std::size_t chunk);
+
+  /// Names of the collections to decode, empty if all collections are read
+  std::vector<std::string> collectionsToRead();
+
+  /// Read the (run, event) pairs from EventList and EventListFile
+  StatusCode readEventSelection();
+
+  /// Read the next selected event, nullptr at the end of the input
+  std::unique_ptr<EVENT::LCEvent> readNextEvent();
+
+  /// Read the next event together with the information whether it is the last one
+  QueuedEvent readQueuedEvent();
+
+  /// Put the run header of the event in the event store, reading it when the run changes
+  StatusCode registerRunHeader(int run);
+
+  /// Run header of the run from the input, one with only the run number if there is none
+  std::shared_ptr<EVENT::LCRunHeader> readRunHeader(int run);
+
+  /// Reading stage of the pipeline: fill the queue until the input is exhausted or the queue is closed
+  void readEvents();
+
   Gaudi::Property<std::vector<std::string>> m_fileNames{this, "Files", {}};
-  IO::LCReader*                             m_reader = nullptr;
+  Gaudi::Property<unsigned int>             m_eventsInFlight{
+      this, "EventsInFlight", 0, "Number of events read ahead on a separate thread, 0 reads in the event loop"};
+  Gaudi::Property<std::vector<std::string>> m_collections{
+      this, "Collections", {}, "Only decode these collections from the input, all if empty"};
+  Gaudi::Property<std::vector<std::string>> m_dropCollections{
+      this, "DropCollections", {}, "Do not decode these collections from the input"};
+  Gaudi::Property<unsigned int> m_skipEvents{this, "SkipEvents", 0, "Number of events to skip at the start"};
+  Gaudi::Property<std::vector<std::pair<int, int>>> m_eventList{
+      this, "EventList", {}, "Only process these (run, event) pairs, in the given order"};
+  Gaudi::Property<std::string> m_eventListFile{
+      this, "EventListFile", "", "File with one 'run event' pair per line to process, in the given order"};
+  Gaudi::Property<int> m_numberOfEvents{
+      this, "NumberOfEvents", -1, "Number of events to read after SkipEvents, all if negative"};
+  Gaudi::Property<unsigned int> m_shardIndex{this, "ShardIndex", 0, "Index of the part of the input read by this job"};
+  Gaudi::Property<unsigned int> m_shardCount{
+      this, "ShardCount", 1, "Number of equal parts the input is split into by event count"};
+  Gaudi::Property<unsigned int> m_numberOfProcesses{
+      this, "NumberOfProcesses", 1, "Number of processes to fork after initialize to process the events"};
+  Gaudi::Property<unsigned int> m_chunkSize{
+      this, "ChunkSize", 10, "Number of consecutive events claimed at once by a worker process or job"};
+  Gaudi::Property<std::string> m_workQueue{
+      this, "WorkQueue", "", "Directory shared by jobs taking chunks of events from a common queue"};
+  Gaudi::Property<bool> m_runHeaders{
+      this, "RunHeaders", false,
+      "Put the run header of every event in the event store for processRunHeader, read with a second reader"};
+  Gaudi::Property<std::string> m_traceFile{
+      this, "TraceFile", "", "Chrome trace of reading, conversions and processors, also enables the processor wrappers"};
+  Gaudi::Property<std::string> m_metricsFile{
+      this, "MetricsFile", "", "Prometheus text file with the live metrics, also enables the processor wrappers"};
+  Gaudi::Property<unsigned int> m_metricsInterval{this, "MetricsInterval", 10, "Seconds between updates of the metrics"};
+
+  std::unique_ptr<MT::LCReader> m_reader;
+
+  /// Direct access reader for the run headers, opened for the first event
+  std::unique_ptr<MT::LCReader>         m_runHeaderReader;
+  std::shared_ptr<EVENT::LCRunHeader>   m_runHeader;
+  std::shared_ptr<k4MW::util::RunCache> m_runCache;
+
+  std::vector<std::pair<int, int>> m_selectedEvents;
+  std::vector<std::pair<int, int>> m_missingEvents;
+
+  /// Position in the selected events or in the input after SkipEvents
+  std::size_t m_nextIndex      = 0;
+  std::size_t m_chunkEnd       = 0;
+  std::size_t m_readerPosition = 0;
+  /// Range of positions read by this job, shared by all its worker processes
+  std::size_t m_firstIndex = 0;
+  std::size_t m_endIndex   = std::numeric_limits<std::size_t>::max();
+
+  std::unique_ptr<k4MW::util::ChunkCounter> m_chunkCounter;
+  std::vector<pid_t>                        m_workers;
+  /// Chunks claimed by the reader of this process, the last one is being read
+  std::vector<std::size_t> m_claimedChunks;
+  /// Set by the reader once no events are left for this process
+  bool m_inputDone = false;
+  /// Chunk of the event in the event loop, and the chunks marked as completed
+  std::optional<std::size_t> m_processingChunk;
+  std::set<std::size_t>      m_completedChunks;
+  /// Set when the last event of this process entered the event loop
+  bool m_lastEventStarted = false;
+
+  /// Next event when reading in the event loop
+  QueuedEvent m_nextEvent;
+
+  using EventQueue = k4MW::util::SPSCQueue<QueuedEvent>;
+  std::unique_ptr<EventQueue> m_eventQueue;
+  std::thread                 m_readerThread;
+  std::string                 m_readerError;
+
+  /// Time the event loop spent waiting for the reader
+  std::chrono::steady_clock::duration m_readWait{};
+  unsigned int                        m_eventsRead = 0;
+
+  /// Live metrics, only set if they are exported
+  k4MW::util::MetricCounter*   m_eventsMetric = nullptr;
+  k4MW::util::MetricHistogram* m_readMetric   = nullptr;
+  k4MW::util::MetricHistogram* m_waitMetric   = nullptr;
 };
 
 #endif
\ No newline at end of file
@@ -21,10 +21,16 @@
 #define K4MARLINWRAPPER_MARLINPROCESSORWRAPPER_H
 
 // std
+#include <array>
 #include <stack>
 #include <cstdlib>
 #include <iostream>
+#include <map>
+#include <memory>
+#include <optional>
 #include <string>
+#include <utility>
+#include <vector>
 
 // Gaudi
 #include <GaudiAlg/GaudiAlgorithm.h>
@@ -47,6 +53,16 @@
 
 // k4MarlinWrapper
 #include "k4MarlinWrapper/LCEventWrapper.h"
+#include "k4MarlinWrapper/LCRunHeaderWrapper.h"
+#include "k4MarlinWrapper/ProcessorReturnValues.h"
+#include "k4MarlinWrapper/util/AsyncLogSink.h"
+#include "k4MarlinWrapper/util/LibraryIndex.h"
+#include "k4MarlinWrapper/util/LogScope.h"
+#include "k4MarlinWrapper/util/LogicalExpression.h"
+#include "k4MarlinWrapper/util/MetricsExporter.h"
+#include "k4MarlinWrapper/util/ProcessorProfile.h"
+#include "k4MarlinWrapper/util/StartupProfile.h"
+#include "k4MarlinWrapper/util/TraceRecorder.h"
 #include "k4MarlinWrapper/util/k4MarlinWrapperUtil.h"
 #include "k4MarlinWrapper/converters/IEDMConverter.h"
 
@@ -63,14 +79,72 @@ public:
   virtual StatusCode execute() override final;
   virtual StatusCode finalize() override final;
   virtual StatusCode initialize() override final;
+  virtual StatusCode start() override final;
 
 private:
   std::string           m_verbosity = "MESSAGE";
+  /// streamlog name and level of the processor, switched to in every call
+  k4MW::util::LogScopeToken m_logScope;
   marlin::Processor*    m_processor = nullptr;
+  /// Processor init is deferred until the output tag of a forked worker is known
+  bool                  m_deferredInit = false;
 
-  /// Load libraries specified by MARLIN_DLL environment variable
+  /// Run of the last run header given to the processor
+  std::optional<int> m_run;
+
+  /// Seeds for this processor only, from RandomSeed and the processor name
+  std::unique_ptr<marlin::ProcessorEventSeeder> m_eventSeeder;
+  std::unique_ptr<marlin::StringParameters>     m_seedParameters;
+
+  /// Time spent in the conversions and the processor, if profiling is enabled
+  std::shared_ptr<k4MW::util::ProcessorProfile> m_profile;
+
+  /// Names of the trace spans of the conversions and the processor
+  std::array<const char*, k4MW::util::ProcessorProfile::NStages> m_traceNames{};
+
+  /// Set once the memory growth of this processor passed MemoryGrowthWarning
+  bool m_memoryWarned = false;
+
+  /// Input collections of the processor, for the scaling fit and SkipEmptyInputs
+  std::vector<std::string> m_inputCollections;
+
+  /// Condition on the return values of the processors before this one, if any
+  std::optional<k4MW::util::LogicalExpression> m_conditionExpression;
+  /// Events in which the condition was false
+  std::uint64_t m_conditionFalse = 0;
+
+  /// Events in which the processor threw SkipEventException
+  std::uint64_t m_skippedEvents = 0;
+
+  /// Events skipped because all inputs were empty or missing
+  std::uint64_t m_emptyInputsSkipped = 0;
+
+  /// Events in which this processor went over TimeBudget or EventTimeBudget
+  std::uint64_t m_overBudget = 0;
+
+  /// Live latency histograms of the conversions and the processor, if metrics are exported
+  std::array<k4MW::util::MetricHistogram*, k4MW::util::ProcessorProfile::NStages> m_metrics{};
+
+  /// Check that a job-wide option agrees with the other wrappers. The first non-default value sets the option for
+  /// the job, or with firstDecides the value of the first wrapper, which applies it before the others are initialized.
+  template <typename T>
+  bool checkJobOption(const Gaudi::Property<T>& property, const T& unset, bool firstDecides) const;
+
+  /// Load libraries specified by MARLIN_DLL environment variable, and write the ProcessorLibraryIndex if set
   StatusCode loadProcessorLibraries() const;
 
+  /// Load one library of MARLIN_DLL unless it is loaded already
+  StatusCode loadProcessorLibrary(const std::string& library) const;
+
+  /// Load the library of the processor type from the ProcessorLibraryIndex, all of MARLIN_DLL if it is not known
+  StatusCode loadLibraryFor(const std::string& processorType) const;
+
+  /// Print the startup time by phase and processor, and write it to the StartupFile
+  void writeStartupReport() const;
+
+  /// Print the time saved by loading only the libraries of the processors used
+  void reportLibraryLoading() const;
+
   /// Instantiate the Marlin processor and assign name and parameters
   StatusCode instantiateProcessor(
     std::shared_ptr<marlin::StringParameters>& parameters,
@@ -78,17 +152,114 @@ private:
 
   /// Parse the parameters from the Property
   std::shared_ptr<marlin::StringParameters> parseParameters(
-    const Gaudi::Property<std::map<std::string, std::vector<std::string>>>& parameters,
+    const std::map<std::string, std::vector<std::string>>& parameters,
     std::string& verbosity) const;
 
+  /// Parameters with the output tag of a split job applied to the output file name
+  std::map<std::string, std::vector<std::string>> taggedParameters() const;
+
+  /// Call init of the processor in its log scope, without the event seeder for an independent one on the init pool
+  void initProcessor(bool concurrent = false);
+
+  /// Call init of the processors deferred by ParallelInit, the independent ones on a thread pool
+  StatusCode initPendingProcessors();
+
+  /// Set up the event seeder of this processor
+  void createEventSeeder();
+
+  /// Call processRunHeader of the processor
+  void processRunHeader(const LCRunHeaderWrapper* runHeader);
+
+  /// Whether the condition holds for the return values of the event
+  bool conditionIsTrue();
+
+#ifdef K4MARLINWRAPPER_RETURN_VALUES
+  /// Store the return values of the processor for the conditions of the processors after it
+  StatusCode publishReturnValues();
+#endif
+
+  /// Drop an event that went over the time budget and write it to the OverBudgetFile
+  void dropOverBudgetEvent(LCEventWrapper* eventWrapper, double processorSeconds, double eventSeconds);
+
+  /// Bookkeeping once the last processor is done with the event
+  void completeEvent() const;
+
+  /// Print the profile of all processors and write it to the profile file
+  void writeProfileReport() const;
+
+  /// Names of the input collections set in the processor parameters
+  std::vector<std::string> inputCollections() const;
+
+  /// Number of elements in the input collections present in the event
+  std::int64_t inputSize(const EVENT::LCEvent* event) const;
+
   /// ProcessorType: The Type of the MarlinProcessor to use
   Gaudi::Property<std::string> m_processorType{this, "ProcessorType", {}};
   Gaudi::Property<std::map<std::string, std::vector<std::string>>> m_parameters{this, "Parameters", {}};
+  Gaudi::Property<std::string> m_condition{
+      this, "Condition", "", "Run only if this Marlin condition on the return values of earlier processors is true"};
+  Gaudi::Property<bool> m_skipEmptyInputs{
+      this, "SkipEmptyInputs", false, "Skip the processor in events where all its input collections are empty or missing"};
+  Gaudi::Property<std::vector<std::string>> m_declaredInputs{
+      this, "InputCollections", {}, "Inputs for SkipEmptyInputs and CostModel, by default the input collection parameters"};
+  Gaudi::Property<double> m_timeBudget{this, "TimeBudget", 0.,
+                                       "Seconds per event for this processor, checked when it returns: the rest of an "
+                                       "event over it is skipped, a running processor is never interrupted. 0 for none"};
+  Gaudi::Property<double> m_eventTimeBudget{this, "EventTimeBudget", 0.,
+                                            "Seconds per event for all processors, checked when each returns: the rest "
+                                            "of an event over it is skipped, a running processor is never interrupted"};
+  Gaudi::Property<std::string> m_overBudgetFile{
+      this, "OverBudgetFile", "overBudgetEvents.txt", "File listing the 'run event' pairs skipped for their time"};
+  Gaudi::Property<unsigned int> m_randomSeed{
+      this, "RandomSeed", 123456, "Global seed, combined with the processor name, run and event number"};
+  Gaudi::Property<bool> m_enableProfile{
+      this, "Profile", false, "Measure the time spent in the conversions and the processor"};
+  Gaudi::Property<bool> m_hardwareCounters{
+      this, "HardwareCounters", false, "Profile the processor with perf counters: cycles, instructions, cache misses..."};
+  Gaudi::Property<bool> m_memoryTracking{
+      this, "MemoryTracking", false, "Profile the growth of the resident set and the heap in the processor"};
+  Gaudi::Property<double> m_memoryGrowthWarning{
+      this, "MemoryGrowthWarning", 100., "Warn when the heap or resident set grew by this many MB in the processor"};
+  Gaudi::Property<bool> m_costModel{
+      this, "CostModel", false, "Fit the processor time per event against the number of elements in its inputs"};
+  Gaudi::Property<double> m_superlinearExponent{
+      this, "SuperlinearExponent", 1.2, "Flag processors whose time grows faster than size^SuperlinearExponent"};
+  Gaudi::Property<std::string> m_profileFile{
+      this, "ProfileFile", "", "File for the profile of all processors, CSV if it ends with .csv, JSON otherwise"};
+  Gaudi::Property<std::string> m_metricsFile{
+      this, "MetricsFile", "", "Prometheus text file with the live metrics, enables them for all wrappers"};
+  Gaudi::Property<unsigned int> m_metricsInterval{this, "MetricsInterval", 10, "Seconds between updates of the metrics"};
+  Gaudi::Property<std::string> m_traceFile{
+      this, "TraceFile", "", "Chrome trace of the conversions and processors, enables tracing for all wrappers"};
+
+  Gaudi::Property<std::string> m_libraryIndex{
+      this, "ProcessorLibraryIndex", "", "File mapping processor types to MARLIN_DLL libraries, built if missing"};
+  Gaudi::Property<std::string> m_startupFile{
+      this, "StartupFile", "", "JSON file for the startup time by phase and processor, printed in any case"};
+  Gaudi::Property<unsigned int> m_parallelInit{
+      this, "ParallelInit", 0, "Threads for the init of the IndependentInit processors, 0 to call init in order"};
+  Gaudi::Property<bool> m_independentInit{
+      this, "IndependentInit", false, "The init of the processor uses no global state, nor the event seeder"};
+  Gaudi::Property<bool> m_asyncLogging{
+      this, "AsyncLogging", false, "Write the output of the processors from a background thread"};
+  Gaudi::Property<unsigned int> m_logRateLimit{
+      this, "LogRateLimit", 0, "Lines per message and LogRateWindow of the processors, 0 for no limit"};
+  Gaudi::Property<unsigned int> m_logRateWindow{this, "LogRateWindow", 10, "Seconds of the window of LogRateLimit"};
 
   ToolHandle<IEDMConverter> m_edm_conversionTool{"IEDMConverter/EDM4hep2Lcio", this};
   ToolHandle<IEDMConverter> m_lcio_conversionTool{"IEDMConverter/Lcio2EDM4hep", this};
 
   static std::stack<marlin::Processor*>& ProcessorStack();
+  static k4MW::util::ProcessorProfiles&  Profiles();
+  static std::string&                    ProfileFile();
+  static k4MW::util::MetricCounter*&     EventsMetric();
+  static bool&                           ReturnValuesUsed();
+  static double&                         EventTimeBudget();
+  static k4MW::util::StartupProfile&     Startup();
+  static std::string&                    StartupFile();
+  static unsigned int&                   InitThreads();
+  static std::vector<MarlinProcessorWrapper*>& PendingInits();
+  static std::map<std::string, std::pair<std::string, std::string>>& JobOptions();
 };
 
 std::stack<marlin::Processor*>& MarlinProcessorWrapper::ProcessorStack() {
@@ -96,4 +267,55 @@ std::stack<marlin::Processor*>& MarlinProcessorWrapper::ProcessorStack() {
   return stack;
 }
 
+k4MW::util::ProcessorProfiles& MarlinProcessorWrapper::Profiles() {
+  static k4MW::util::ProcessorProfiles profiles;
+  return profiles;
+}
+
+std::string& MarlinProcessorWrapper::ProfileFile() {
+  static std::string file;
+  return file;
+}
+
+k4MW::util::MetricCounter*& MarlinProcessorWrapper::EventsMetric() {
+  static k4MW::util::MetricCounter* counter = nullptr;
+  return counter;
+}
+
+k4MW::util::StartupProfile& MarlinProcessorWrapper::Startup() {
+  static k4MW::util::StartupProfile startup;
+  return startup;
+}
+
+std::string& MarlinProcessorWrapper::StartupFile() {
+  static std::string file;
+  return file;
+}
+
+unsigned int& MarlinProcessorWrapper::InitThreads() {
+  static unsigned int threads = 0;
+  return threads;
+}
+
+std::vector<MarlinProcessorWrapper*>& MarlinProcessorWrapper::PendingInits() {
+  static std::vector<MarlinProcessorWrapper*> wrappers;
+  return wrappers;
+}
+
+// Value of every job-wide option and the wrapper it was taken from
+std::map<std::string, std::pair<std::string, std::string>>& MarlinProcessorWrapper::JobOptions() {
+  static std::map<std::string, std::pair<std::string, std::string>> options;
+  return options;
+}
+
+double& MarlinProcessorWrapper::EventTimeBudget() {
+  static double budget = 0;
+  return budget;
+}
+
+bool& MarlinProcessorWrapper::ReturnValuesUsed() {
+  static bool used = false;
+  return used;
+}
+
 #endif
\ No newline at end of file
@@ -0,0 +1,48 @@
+/**
+ *   Copyright 2019 CERN
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ *
+ *   In applying this licence, CERN does not waive the privileges and immunities
+ *   granted to it by virtue of its status as an Intergovernmental Organization
+ *   or submit itself to any jurisdiction.
+ *
+ */
+
+#ifndef K4MARLINWRAPPER_PROCESSORRETURNVALUES_H
+#define K4MARLINWRAPPER_PROCESSORRETURNVALUES_H
+
+#include <map>
+#include <string>
+
+#include <GaudiKernel/DataObject.h>
+
+// Return values the processors set in the current event, by processor name and by
+// "processor.value" for named values, for the conditions of the processors after them
+class ProcessorReturnValues : public DataObject {
+public:
+  static constexpr const char* Location = "/Event/MarlinReturnValues";
+
+  void set(const std::string& name, bool value) { m_values[name] = value; }
+
+  // Values of processors that did not run in this event are false
+  bool get(const std::string& name) const {
+    const auto value = m_values.find(name);
+    return value != m_values.end() and value->second;
+  }
+
+private:
+  std::map<std::string, bool> m_values;
+};
+
+#endif
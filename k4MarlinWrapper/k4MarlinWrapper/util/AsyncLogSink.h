@@ -0,0 +1,277 @@
+#ifndef K4MARLINWRAPPER_ASYNCLOGSINK_H
+#define K4MARLINWRAPPER_ASYNCLOGSINK_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <ostream>
+#include <streambuf>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include <pthread.h>
+
+#include "k4MarlinWrapper/util/SPSCQueue.h"
+
+namespace k4MW::util {
+
+// Stream for streamlog that hands complete lines to a background thread, which
+// writes them to the real output. Every thread fills its own lock-free queue,
+// so the lines of one thread keep their order and logging threads never wait
+// for the output unless their queue is full. Lines that repeat from the same
+// place, i.e. that only differ in their numbers, are limited to a number per
+// time window; the count of suppressed lines is written when the window ends.
+//
+// The lines go to the stream streamlog would write to without the sink, not to
+// the IMessageSvc: the processors' output then looks the same with and without
+// AsyncLogging, and Gaudi's format and OutputLevel are not applied on top of
+// the streamlog name and Verbosity.
+class AsyncLogSink : public std::streambuf {
+public:
+  static AsyncLogSink& instance() {
+    static AsyncLogSink sink;
+    return sink;
+  }
+
+  ~AsyncLogSink() override { stop(); }
+
+  AsyncLogSink(const AsyncLogSink&) = delete;
+  AsyncLogSink& operator=(const AsyncLogSink&) = delete;
+
+  // Stream to give to streamlog::out.init
+  std::ostream& stream() { return m_stream; }
+
+  // Lines per message site and window, 0 for no limit
+  void start(std::ostream& target, unsigned rateLimit, std::chrono::seconds window) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_target    = &target;
+    m_rateLimit = rateLimit;
+    m_window    = window;
+    m_stopped   = false;
+    startWriter();
+  }
+
+  // Write all pending lines; lines logged afterwards are written directly
+  void stop() {
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      if (not m_running) {
+        return;
+      }
+      m_stopped = true;
+      m_running = false;
+    }
+    // threads that saw the writer running finish queueing their line
+    while (m_publishing.load() > 0) {
+      std::this_thread::yield();
+    }
+    m_writer.join();
+    // lines queued while the writer was finishing
+    drain();
+    m_target->flush();
+  }
+
+protected:
+  int_type overflow(int_type character) override {
+    if (character != traits_type::eof()) {
+      const char c = traits_type::to_char_type(character);
+      xsputn(&c, 1);
+    }
+    return character;
+  }
+
+  std::streamsize xsputn(const char* text, std::streamsize size) override {
+    auto& line = pendingLine();
+    for (std::streamsize index = 0; index < size; ++index) {
+      line.push_back(text[index]);
+      if (text[index] == '\n') {
+        publish(line);
+      }
+    }
+    return size;
+  }
+
+  // streamlog flushes after every message, a line without newline stays pending
+  int sync() override { return 0; }
+
+private:
+  using LineQueue = SPSCQueue<std::string>;
+
+  struct Site {
+    std::chrono::steady_clock::time_point windowStart;
+    unsigned                              lines      = 0;
+    std::uint64_t                         suppressed = 0;
+  };
+
+  AsyncLogSink() : m_stream(this) {
+    // the writer thread does not survive fork(), the child drops the lines the parent
+    // still has to write and starts its own writer
+    pthread_atfork(nullptr, nullptr, [] { instance().restartAfterFork(); });
+  }
+
+  static std::string& pendingLine() {
+    thread_local std::string line;
+    return line;
+  }
+
+  LineQueue& queue() {
+    thread_local LineQueue* threadQueue = nullptr;
+    if (threadQueue == nullptr) {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_queues.push_back(std::make_unique<LineQueue>(4096));
+      threadQueue = m_queues.back().get();
+    }
+    return *threadQueue;
+  }
+
+  void publish(std::string& line) {
+    ++m_publishing;
+    if (m_running.load()) {
+      queue().push(std::move(line));
+      line.clear();
+      --m_publishing;
+      return;
+    }
+    --m_publishing;
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      if (not m_restart) {
+        if (m_target != nullptr) {
+          *m_target << line << std::flush;
+        }
+        line.clear();
+        return;
+      }
+      m_restart = false;
+      startWriter();
+    }
+    publish(line);
+  }
+
+  void startWriter() {
+    m_running = true;
+    m_writer  = std::thread([this] { run(); });
+  }
+
+  void run() {
+    for (;;) {
+      bool stopped = false;
+      {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        stopped = m_stopped;
+      }
+      if (drain()) {
+        m_target->flush();
+      } else if (stopped) {
+        break;
+      } else {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+      }
+    }
+    for (const auto& [site, state] : m_sites) {
+      if (state.suppressed > 0) {
+        *m_target << "Suppressed " << state.suppressed << " more messages like: " << site << '\n';
+      }
+    }
+    m_sites.clear();
+    m_target->flush();
+  }
+
+  // Write the lines of all queues, returns whether there were any
+  bool drain() {
+    std::string line;
+    bool        written = false;
+    for (std::size_t index = 0; index < queueCount(); ++index) {
+      auto& queue = queueAt(index);
+      while (queue.tryPop(line)) {
+        write(line);
+        written = true;
+      }
+    }
+    return written;
+  }
+
+  std::size_t queueCount() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_queues.size();
+  }
+
+  LineQueue& queueAt(std::size_t index) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return *m_queues[index];
+  }
+
+  // The site of a line is its text without the numbers, which change between events
+  static std::string siteOf(const std::string& line) {
+    std::string site;
+    for (const char c : line) {
+      if (c == '\n' or site.size() >= 120) {
+        break;
+      }
+      if (c < '0' or c > '9') {
+        site.push_back(c);
+      }
+    }
+    return site;
+  }
+
+  void write(const std::string& line) {
+    if (m_rateLimit == 0) {
+      *m_target << line;
+      return;
+    }
+    const auto now  = std::chrono::steady_clock::now();
+    auto&      site = m_sites[siteOf(line)];
+    if (now - site.windowStart > m_window) {
+      if (site.suppressed > 0) {
+        *m_target << "Suppressed " << site.suppressed << " messages like: " << siteOf(line) << '\n';
+      }
+      site = Site{now, 0, 0};
+    }
+    if (site.lines < m_rateLimit) {
+      ++site.lines;
+      *m_target << line;
+    } else {
+      ++site.suppressed;
+    }
+  }
+
+  void restartAfterFork() {
+    new (&m_mutex) std::mutex();
+    for (auto& queue : m_queues) {
+      std::string dropped;
+      while (queue->tryPop(dropped)) {
+      }
+    }
+    if (m_running) {
+      // the handle refers to the writer of the parent, it can neither be joined nor destroyed,
+      // the next line logged in the child starts a new writer
+      new (&m_writer) std::thread();
+      m_running    = false;
+      m_publishing = 0;
+      m_restart = true;
+    }
+  }
+
+  std::ostream                            m_stream;
+  std::ostream*                           m_target = nullptr;
+  std::mutex                              m_mutex;
+  std::thread                             m_writer;
+  std::atomic<bool>                       m_running{false};
+  std::atomic<unsigned>                   m_publishing{0};
+  bool                                    m_stopped   = false;
+  bool                                    m_restart   = false;
+  unsigned                                m_rateLimit = 0;
+  std::chrono::seconds                    m_window{10};
+  std::vector<std::unique_ptr<LineQueue>> m_queues;
+  std::unordered_map<std::string, Site>   m_sites;
+};
+
+}
+
+#endif
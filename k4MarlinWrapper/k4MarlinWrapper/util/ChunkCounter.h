@@ -0,0 +1,26 @@
+#ifndef K4MARLINWRAPPER_CHUNKCOUNTER_H
+#define K4MARLINWRAPPER_CHUNKCOUNTER_H
+
+#include <cstddef>
+#include <vector>
+
+namespace k4MW::util {
+
+// Hands out consecutive chunk indices to the processes sharing a job's input
+class ChunkCounter {
+public:
+  virtual ~ChunkCounter() = default;
+
+  // Index of the next unclaimed chunk
+  virtual std::size_t claim() = 0;
+
+  // Record that all events of a claimed chunk went through the event loop
+  virtual void complete(std::size_t /*chunk*/) {}
+
+  // Chunks below chunkCount that were claimed but not completed, only known by counters that outlive the job
+  virtual std::vector<std::size_t> incomplete(std::size_t /*chunkCount*/) { return {}; }
+};
+
+}
+
+#endif
@@ -0,0 +1,120 @@
+#ifndef K4MARLINWRAPPER_FILECHUNKCOUNTER_H
+#define K4MARLINWRAPPER_FILECHUNKCOUNTER_H
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <set>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "k4MarlinWrapper/util/ChunkCounter.h"
+
+namespace k4MW::util {
+
+// Counter stored as text in a file, shared by independent jobs on the same or
+// different nodes through a common directory. Every claim takes a POSIX record
+// lock on the file, which is also honoured by NFS and most cluster filesystems.
+// Completed chunks are appended to a second file, <name>.done, so that chunks
+// of jobs that died can be found once the input is exhausted.
+class FileChunkCounter : public ChunkCounter {
+public:
+  FileChunkCounter(const std::string& directory, const std::string& name)
+      : m_path(directory + "/" + name), m_donePath(m_path + ".done") {}
+
+  std::size_t claim() override {
+    const int         fd   = openLocked(m_path, F_WRLCK);
+    const std::size_t next = readCount(fd);
+
+    const std::string text = std::to_string(next + 1) + "\n";
+    const bool written     = pwrite(fd, text.data(), text.size(), 0) == static_cast<ssize_t>(text.size()) and
+                         ftruncate(fd, text.size()) == 0 and fsync(fd) == 0;
+    // closing the file releases the lock
+    close(fd);
+    if (not written) {
+      throw std::runtime_error("Cannot update " + m_path);
+    }
+    return next;
+  }
+
+  void complete(std::size_t chunk) override {
+    const int         fd      = openLocked(m_donePath, F_WRLCK);
+    const std::string text    = std::to_string(chunk) + "\n";
+    const off_t       end     = lseek(fd, 0, SEEK_END);
+    const bool        written = end >= 0 and pwrite(fd, text.data(), text.size(), end) == static_cast<ssize_t>(text.size())
+                         and fsync(fd) == 0;
+    close(fd);
+    if (not written) {
+      throw std::runtime_error("Cannot update " + m_donePath);
+    }
+  }
+
+  std::vector<std::size_t> incomplete(std::size_t chunkCount) override {
+    int               fd      = openLocked(m_path, F_RDLCK);
+    const std::size_t claimed = std::min(readCount(fd), chunkCount);
+    close(fd);
+
+    std::set<std::size_t> done;
+    fd = openLocked(m_donePath, F_RDLCK);
+    std::string text;
+    char        buffer[4096];
+    for (ssize_t size = 0; (size = pread(fd, buffer, sizeof(buffer), text.size())) > 0;) {
+      text.append(buffer, size);
+    }
+    close(fd);
+    std::istringstream lines(text);
+    for (std::size_t chunk = 0; lines >> chunk;) {
+      done.insert(chunk);
+    }
+
+    std::vector<std::size_t> chunks;
+    for (std::size_t chunk = 0; chunk < claimed; ++chunk) {
+      if (done.count(chunk) == 0) {
+        chunks.push_back(chunk);
+      }
+    }
+    return chunks;
+  }
+
+private:
+  // Open and lock a file of the queue, the lock is released when the file is closed
+  static int openLocked(const std::string& path, short type) {
+    const int fd = open(path.c_str(), O_RDWR | O_CREAT, 0644);
+    if (fd < 0) {
+      throw std::runtime_error("Cannot open " + path + ": " + std::strerror(errno));
+    }
+
+    struct flock lock {};
+    lock.l_type   = type;
+    lock.l_whence = SEEK_SET;
+    while (fcntl(fd, F_SETLKW, &lock) < 0) {
+      if (errno != EINTR) {
+        const std::string reason = std::strerror(errno);
+        close(fd);
+        throw std::runtime_error("Cannot lock " + path + ": " + reason);
+      }
+    }
+    return fd;
+  }
+
+  static std::size_t readCount(int fd) {
+    char buffer[32] = {};
+    if (pread(fd, buffer, sizeof(buffer) - 1, 0) < 0) {
+      buffer[0] = '\0';
+    }
+    return std::strtoull(buffer, nullptr, 10);
+  }
+
+  const std::string m_path;
+  const std::string m_donePath;
+};
+
+}
+
+#endif
@@ -0,0 +1,122 @@
+#ifndef K4MARLINWRAPPER_LIBRARYINDEX_H
+#define K4MARLINWRAPPER_LIBRARYINDEX_H
+
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <map>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace k4MW::util {
+
+// Which library of MARLIN_DLL registers which processor type, so that a job only
+// loads the libraries of the processors it uses. The index records the size and
+// modification time of every library and the time it took to load; it is only
+// used while the libraries in MARLIN_DLL match it. The file has one line per
+// library, "library <path> <mtime> <size> <seconds>", and per processor type,
+// "type <ProcessorType> <path>".
+struct LibraryIndex {
+  struct Library {
+    std::string  path;
+    std::int64_t mtime   = -1;
+    std::int64_t size    = -1;
+    double       seconds = 0;
+  };
+
+  std::vector<Library>               libraries;
+  std::map<std::string, std::string> types;
+
+  // Size and modification time, -1 for libraries given by name only and found by the dynamic loader
+  static Library stamp(const std::string& path) {
+    Library library{path};
+    struct stat status;
+    if (stat(path.c_str(), &status) == 0) {
+      library.mtime = status.st_mtime;
+      library.size  = status.st_size;
+    }
+    return library;
+  }
+
+  static std::optional<LibraryIndex> read(const std::string& fileName) {
+    std::ifstream file(fileName);
+    if (not file) {
+      return std::nullopt;
+    }
+    LibraryIndex index;
+    std::string  line;
+    while (std::getline(file, line)) {
+      std::istringstream fields(line);
+      std::string        kind;
+      fields >> kind;
+      if (kind == "library") {
+        Library library;
+        if (not(fields >> library.path >> library.mtime >> library.size >> library.seconds)) {
+          return std::nullopt;
+        }
+        index.libraries.push_back(library);
+      } else if (kind == "type") {
+        std::string type, path;
+        if (not(fields >> type >> path)) {
+          return std::nullopt;
+        }
+        index.types[type] = path;
+      }
+    }
+    return index;
+  }
+
+  // Written to a temporary file and renamed, so that concurrent jobs never read a partial index
+  bool write(const std::string& fileName) const {
+    const auto temporary = fileName + ".tmp" + std::to_string(::getpid());
+    {
+      std::ofstream file(temporary);
+      file << "# processor libraries of MARLIN_DLL, delete to rebuild\n";
+      for (const auto& library : libraries) {
+        file << "library " << library.path << ' ' << library.mtime << ' ' << library.size << ' ' << library.seconds
+             << '\n';
+      }
+      for (const auto& [type, path] : types) {
+        file << "type " << type << ' ' << path << '\n';
+      }
+      if (not file.flush()) {
+        std::remove(temporary.c_str());
+        return false;
+      }
+    }
+    return std::rename(temporary.c_str(), fileName.c_str()) == 0;
+  }
+
+  // Whether the index was built from these libraries, unchanged since
+  bool matches(const std::vector<std::string>& paths) const {
+    if (paths.size() != libraries.size()) {
+      return false;
+    }
+    for (std::size_t position = 0; position < paths.size(); ++position) {
+      const auto current = stamp(paths[position]);
+      const auto& known  = libraries[position];
+      if (current.path != known.path or current.mtime != known.mtime or current.size != known.size) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  const Library* library(const std::string& path) const {
+    for (const auto& library : libraries) {
+      if (library.path == path) {
+        return &library;
+      }
+    }
+    return nullptr;
+  }
+};
+
+}
+
+#endif
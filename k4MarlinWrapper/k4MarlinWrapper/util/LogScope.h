@@ -0,0 +1,137 @@
+#ifndef K4MARLINWRAPPER_LOGSCOPE_H
+#define K4MARLINWRAPPER_LOGSCOPE_H
+
+#include <atomic>
+#include <mutex>
+#include <set>
+#include <string>
+
+#include "streamlog/streamlog.h"
+
+namespace k4MW::util {
+
+// Name and level of the streamlog output of one processor, resolved once in
+// initialize: the name to an interned string and the level to its numeric
+// value and setter. Switching to a token only touches streamlog::out when
+// another token is active, and then only the name or level that differs, so
+// consecutive calls of the same processor cost one comparison. The previous
+// name and level are not restored, the next token sets its own.
+//
+// The active token is an atomic and switching takes a lock, so wrappers on
+// several threads never race on the tokens or on streamlog::out. The name and
+// level themselves live in the process-wide streamlog::out, though: while
+// processors run concurrently, a line may be printed with the name and level
+// of a processor on another thread. MarlinProcessorWrapper warns about this
+// when the event loop has more than one thread.
+class LogScopeToken {
+public:
+  LogScopeToken() = default;
+  LogScopeToken(const std::string& name, const std::string& level) : m_name(&intern(name)), m_level(find(level)) {}
+
+  ~LogScopeToken() { forget(); }
+
+  LogScopeToken(const LogScopeToken&) = default;
+
+  // Assigning keeps the identity of the token, forget it in case it is the active one
+  LogScopeToken& operator=(const LogScopeToken& other) {
+    m_name  = other.m_name;
+    m_level = other.m_level;
+    forget();
+    return *this;
+  }
+
+  // False if the level name is not a streamlog level, the level is then left as it is
+  bool knownLevel() const { return m_level != nullptr; }
+
+  void activate() const {
+    if (m_name == nullptr or active().load(std::memory_order_acquire) == this) {
+      return;
+    }
+    std::lock_guard<std::mutex> lock(mutex());
+    auto&                       state = current();
+    if (state.name != m_name) {
+      streamlog::out.setName(*m_name);
+      state.name = m_name;
+    }
+    if (m_level != nullptr and state.level != long(m_level->value)) {
+      m_level->set();
+      state.level = m_level->value;
+    }
+    active().store(this, std::memory_order_release);
+  }
+
+  // Forget the active name and level, after streamlog::out was changed by other code
+  static void reset() {
+    std::lock_guard<std::mutex> lock(mutex());
+    current() = State{};
+    active().store(nullptr, std::memory_order_release);
+  }
+
+private:
+  struct Level {
+    const char* name;
+    unsigned    value;
+    unsigned (*set)();
+  };
+
+  // What the tokens last set on streamlog::out, guarded by mutex()
+  struct State {
+    const std::string* name  = nullptr;
+    long               level = -1;
+  };
+
+  static State& current() {
+    static State state;
+    return state;
+  }
+
+  static std::atomic<const LogScopeToken*>& active() {
+    static std::atomic<const LogScopeToken*> token{nullptr};
+    return token;
+  }
+
+  static std::mutex& mutex() {
+    static std::mutex lock;
+    return lock;
+  }
+
+  // Another token at the same address must not be taken for the active one
+  void forget() {
+    const LogScopeToken* self = this;
+    active().compare_exchange_strong(self, nullptr);
+  }
+
+  // Names live as long as the process, so that equal names compare as equal pointers
+  static const std::string& intern(const std::string& name) {
+    std::lock_guard<std::mutex> lock(mutex());
+    static std::set<std::string> names;
+    return *names.insert(name).first;
+  }
+
+  template <typename T> static unsigned setLevel() { return streamlog::out.setLevel<T>(); }
+
+  static const Level* find(const std::string& name) {
+#define K4MW_LOG_LEVEL(LEVEL) Level{#LEVEL, streamlog::LEVEL::level, &setLevel<streamlog::LEVEL>}
+#define K4MW_LOG_LEVELS(LEVEL)                                                                                       \
+  K4MW_LOG_LEVEL(LEVEL), K4MW_LOG_LEVEL(LEVEL##0), K4MW_LOG_LEVEL(LEVEL##1), K4MW_LOG_LEVEL(LEVEL##2),               \
+      K4MW_LOG_LEVEL(LEVEL##3), K4MW_LOG_LEVEL(LEVEL##4), K4MW_LOG_LEVEL(LEVEL##5), K4MW_LOG_LEVEL(LEVEL##6),        \
+      K4MW_LOG_LEVEL(LEVEL##7), K4MW_LOG_LEVEL(LEVEL##8), K4MW_LOG_LEVEL(LEVEL##9)
+    static const Level levels[] = {K4MW_LOG_LEVELS(DEBUG), K4MW_LOG_LEVELS(MESSAGE), K4MW_LOG_LEVELS(WARNING),
+                                   K4MW_LOG_LEVELS(ERROR), K4MW_LOG_LEVEL(SILENT)};
+#undef K4MW_LOG_LEVELS
+#undef K4MW_LOG_LEVEL
+    for (const auto& level : levels) {
+      if (name == level.name) {
+        return &level;
+      }
+    }
+    return nullptr;
+  }
+
+  const std::string* m_name  = nullptr;
+  const Level*       m_level = nullptr;
+};
+
+}
+
+#endif
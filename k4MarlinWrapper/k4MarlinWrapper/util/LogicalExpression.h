@@ -0,0 +1,156 @@
+#ifndef K4MARLINWRAPPER_LOGICALEXPRESSION_H
+#define K4MARLINWRAPPER_LOGICALEXPRESSION_H
+
+#include <cctype>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace k4MW::util {
+
+// Condition of a Marlin <if> block, e.g. "MyFilter && !(Veto || Other.isBackground)".
+// Names are processor names, optionally followed by the name of a named return value,
+// true and false are constants. The expression is parsed once into postfix order,
+// evaluating it looks up every name once.
+class LogicalExpression {
+public:
+  explicit LogicalExpression(const std::string& expression) : m_text(expression) {
+    parseOr();
+    skipSpace();
+    if (m_position != m_text.size()) {
+      fail("unexpected '" + m_text.substr(m_position, 1) + "'");
+    }
+  }
+
+  // Names the expression refers to, in order of appearance
+  const std::vector<std::string>& names() const { return m_names; }
+
+  // value(name) gives the value of a name
+  template <class Value> bool evaluate(Value&& value) const {
+    bool stack[64];
+    int  top = -1;
+    for (const int op : m_program) {
+      switch (op) {
+      case True:
+        stack[++top] = true;
+        break;
+      case False:
+        stack[++top] = false;
+        break;
+      case Not:
+        stack[top] = not stack[top];
+        break;
+      case And:
+        --top;
+        stack[top] = stack[top] and stack[top + 1];
+        break;
+      case Or:
+        --top;
+        stack[top] = stack[top] or stack[top + 1];
+        break;
+      default:
+        stack[++top] = value(m_names[op]);
+      }
+    }
+    return stack[top];
+  }
+
+private:
+  // operations are negative, non-negative values are indices of names
+  enum Op : int { True = -1, False = -2, Not = -3, And = -4, Or = -5 };
+
+  void skipSpace() {
+    while (m_position < m_text.size() and std::isspace(static_cast<unsigned char>(m_text[m_position]))) {
+      ++m_position;
+    }
+  }
+
+  bool accept(const char* token) {
+    skipSpace();
+    const std::string symbol(token);
+    if (m_text.compare(m_position, symbol.size(), symbol) == 0) {
+      m_position += symbol.size();
+      return true;
+    }
+    return false;
+  }
+
+  void parseOr() {
+    parseAnd();
+    while (accept("||")) {
+      parseAnd();
+      m_program.push_back(Or);
+    }
+  }
+
+  void parseAnd() {
+    parseNot();
+    while (accept("&&")) {
+      parseNot();
+      m_program.push_back(And);
+    }
+  }
+
+  void parseNot() {
+    if (accept("!")) {
+      parseNot();
+      m_program.push_back(Not);
+      return;
+    }
+    if (accept("(")) {
+      if (++m_depth > MaxDepth) {
+        fail("nested too deeply");
+      }
+      parseOr();
+      if (not accept(")")) {
+        fail("missing ')'");
+      }
+      --m_depth;
+      return;
+    }
+    parseName();
+  }
+
+  void parseName() {
+    skipSpace();
+    const auto start = m_position;
+    while (m_position < m_text.size() and (std::isalnum(static_cast<unsigned char>(m_text[m_position])) or
+                                           m_text[m_position] == '_' or m_text[m_position] == '.')) {
+      ++m_position;
+    }
+    if (m_position == start) {
+      fail(m_position == m_text.size() ? "unexpected end" : "unexpected '" + m_text.substr(m_position, 1) + "'");
+    }
+    const auto name = m_text.substr(start, m_position - start);
+    if (name == "true") {
+      m_program.push_back(True);
+    } else if (name == "false") {
+      m_program.push_back(False);
+    } else {
+      m_program.push_back(int(m_names.size()));
+      m_names.push_back(name);
+    }
+    // the evaluation stack holds at most one value per operand
+    if (m_program.size() > MaxOperands) {
+      fail("too many operands");
+    }
+  }
+
+  [[noreturn]] void fail(const std::string& reason) const {
+    throw std::invalid_argument("Invalid condition \"" + m_text + "\": " + reason + " at position " +
+                                std::to_string(m_position));
+  }
+
+  static constexpr int         MaxDepth    = 32;
+  static constexpr std::size_t MaxOperands = 64;
+
+  std::string              m_text;
+  std::size_t              m_position = 0;
+  int                      m_depth    = 0;
+  std::vector<int>         m_program;
+  std::vector<std::string> m_names;
+};
+
+}
+
+#endif
@@ -0,0 +1,58 @@
+#ifndef K4MARLINWRAPPER_MEMORYUSAGE_H
+#define K4MARLINWRAPPER_MEMORYUSAGE_H
+
+#include <cstdint>
+#include <cstdlib>
+
+#include <fcntl.h>
+#include <malloc.h>
+#include <unistd.h>
+
+namespace k4MW::util {
+
+// Resident set size and heap in use of the process, in bytes. Both are process
+// wide: with several threads, the growth seen around a call also contains what
+// the other threads allocated meanwhile.
+struct MemoryUsage {
+  std::int64_t rss  = 0;
+  std::int64_t heap = 0;
+
+  MemoryUsage operator-(const MemoryUsage& other) const { return {rss - other.rss, heap - other.heap}; }
+
+  MemoryUsage& operator+=(const MemoryUsage& other) {
+    rss += other.rss;
+    heap += other.heap;
+    return *this;
+  }
+
+  static MemoryUsage current() {
+    MemoryUsage usage;
+    // the second field of statm is the number of resident pages, /proc/self is resolved on
+    // every open so that forked workers read their own numbers
+    const int fd = open("/proc/self/statm", O_RDONLY);
+    if (fd >= 0) {
+      char       buffer[128];
+      const auto size = read(fd, buffer, sizeof(buffer) - 1);
+      close(fd);
+      if (size > 0) {
+        buffer[size] = '\0';
+        char* fields = buffer;
+        std::strtoll(fields, &fields, 10);
+        usage.rss = std::strtoll(fields, nullptr, 10) * sysconf(_SC_PAGESIZE);
+      }
+    }
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 33))
+    const auto info = mallinfo2();
+    usage.heap      = info.uordblks + info.hblkhd;
+#elif defined(__GLIBC__)
+    // the fields of mallinfo wrap around at 2 GB
+    const auto info = mallinfo();
+    usage.heap      = std::int64_t(unsigned(info.uordblks)) + unsigned(info.hblkhd);
+#endif
+    return usage;
+  }
+};
+
+}
+
+#endif
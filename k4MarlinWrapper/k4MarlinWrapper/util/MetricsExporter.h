@@ -0,0 +1,298 @@
+#ifndef K4MARLINWRAPPER_METRICSEXPORTER_H
+#define K4MARLINWRAPPER_METRICSEXPORTER_H
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <mutex>
+#include <new>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <pthread.h>
+
+#include "k4MarlinWrapper/util/MemoryUsage.h"
+#include "k4MarlinWrapper/util/k4MarlinWrapperUtil.h"
+
+namespace k4MW::util {
+
+// Monotonic counter, updated from any thread without locking
+class MetricCounter {
+public:
+  void          add(std::uint64_t count = 1) { m_value.fetch_add(count, std::memory_order_relaxed); }
+  std::uint64_t value() const { return m_value.load(std::memory_order_relaxed); }
+
+private:
+  std::atomic<std::uint64_t> m_value{0};
+};
+
+// Prometheus histogram of durations with fixed buckets; an update is a few
+// relaxed atomic increments, so it can be fed from the event loop directly
+class MetricHistogram {
+public:
+  static constexpr std::array<double, 12> Bounds = {1e-4, 5e-4, 1e-3, 5e-3, 1e-2, 5e-2, 0.1, 0.5, 1., 5., 10., 60.};
+
+  void observe(std::uint64_t nanoseconds) {
+    std::size_t bucket = 0;
+    while (bucket < Bounds.size() and nanoseconds > Bounds[bucket] * 1e9) {
+      ++bucket;
+    }
+    m_buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+    m_sum.fetch_add(nanoseconds, std::memory_order_relaxed);
+  }
+
+  // Counts per bucket, the last one above the largest bound
+  std::array<std::uint64_t, Bounds.size() + 1> buckets() const {
+    std::array<std::uint64_t, Bounds.size() + 1> counts{};
+    for (std::size_t bucket = 0; bucket < counts.size(); ++bucket) {
+      counts[bucket] = m_buckets[bucket].load(std::memory_order_relaxed);
+    }
+    return counts;
+  }
+
+  double sumSeconds() const { return m_sum.load(std::memory_order_relaxed) * 1e-9; }
+
+private:
+  std::array<std::atomic<std::uint64_t>, Bounds.size() + 1> m_buckets{};
+  std::atomic<std::uint64_t>                                 m_sum{0};
+};
+
+// Writes the registered metrics in the Prometheus text format every few seconds
+// from a background thread, replacing the file atomically so that the textfile
+// collector of the node exporter never sees a partial file. The event loop only
+// touches the atomics of the counters and histograms. Every series carries the
+// component writing it and the output tag of split jobs as labels.
+class MetricsExporter {
+public:
+  // One exporter per process for LcioEvent and the processor wrappers, defined in the k4MarlinWrapperUtil library
+  static MetricsExporter& instance();
+
+  ~MetricsExporter() { stop(); }
+
+  MetricsExporter(const MetricsExporter&) = delete;
+  MetricsExporter& operator=(const MetricsExporter&) = delete;
+
+  // The first component to enable the export chooses the file and the interval
+  void enable(const std::string& file, unsigned intervalSeconds) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (not m_file.empty()) {
+      return;
+    }
+    m_file     = file;
+    m_interval = std::chrono::seconds(std::max(intervalSeconds, 1u));
+    m_enabled.store(true, std::memory_order_release);
+  }
+
+  bool enabled() const { return m_enabled.load(std::memory_order_relaxed); }
+
+  // Metrics are registered before the event loop, the returned references stay valid
+  MetricCounter& counter(const std::string& name, const std::string& help, const std::string& component,
+                         const std::string& labels = "") {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_counters.emplace_back();
+    m_series.push_back({name, help, seriesLabels(component, labels), &m_counters.back(), nullptr});
+    return m_counters.back();
+  }
+
+  MetricHistogram& histogram(const std::string& name, const std::string& help, const std::string& component,
+                             const std::string& labels = "") {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_histograms.emplace_back();
+    m_series.push_back({name, help, seriesLabels(component, labels), nullptr, &m_histograms.back()});
+    return m_histograms.back();
+  }
+
+  // Counter whose rate per second over the last interval is exported as an extra gauge
+  void addRate(const MetricCounter& counter, const std::string& name, const std::string& help,
+               const std::string& component) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_rates.push_back({&counter, name, help, seriesLabels(component, ""), counter.value(), 0});
+  }
+
+  // Start the writer thread if it is not running in this process, cheap once it is.
+  // Called from the event loop, so that forked workers start their own writer.
+  void ensureRunning() {
+    if (enabled() and not m_running.load(std::memory_order_acquire)) {
+      start();
+    }
+  }
+
+  // Stop the writer thread and write the final numbers, called by every component at the end of the job
+  void stop() {
+    bool running = false;
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      running    = m_running;
+      m_stopping = true;
+    }
+    if (running) {
+      m_wakeUp.notify_all();
+      m_thread.join();
+      m_running = false;
+    }
+    if (enabled()) {
+      write();
+    }
+  }
+
+  // Replace the metrics file with the current numbers
+  bool write() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    const auto tag  = outputTag();
+    const auto file = taggedFileName(m_file, tag);
+    const auto partLabel = tag.empty() ? std::string() : "part=\"" + tag + "\"";
+    const auto part      = tag.empty() ? std::string() : "," + partLabel;
+
+    // the series of one family must follow each other
+    auto ordered = m_series;
+    std::stable_sort(ordered.begin(), ordered.end(),
+                     [](const auto& lhs, const auto& rhs) { return lhs.name < rhs.name; });
+
+    std::ostringstream out;
+    std::string        family;
+    for (const auto& series : ordered) {
+      const auto labels = series.labels + part;
+      if (series.name != family) {
+        out << "# HELP " << series.name << ' ' << series.help << '\n';
+        out << "# TYPE " << series.name << (series.counter != nullptr ? " counter" : " histogram") << '\n';
+        family = series.name;
+      }
+      if (series.counter != nullptr) {
+        out << series.name << '{' << labels << "} " << series.counter->value() << '\n';
+        continue;
+      }
+      const auto    counts     = series.histogram->buckets();
+      std::uint64_t cumulative = 0;
+      for (std::size_t bucket = 0; bucket < counts.size(); ++bucket) {
+        cumulative += counts[bucket];
+        out << series.name << "_bucket{" << labels << ",le=\"";
+        if (bucket < MetricHistogram::Bounds.size()) {
+          out << MetricHistogram::Bounds[bucket];
+        } else {
+          out << "+Inf";
+        }
+        out << "\"} " << cumulative << '\n';
+      }
+      out << series.name << "_sum{" << labels << "} " << series.histogram->sumSeconds() << '\n';
+      out << series.name << "_count{" << labels << "} " << cumulative << '\n';
+    }
+
+    // a write shortly after the previous one, e.g. the final one, keeps the last rates
+    const auto   now     = std::chrono::steady_clock::now();
+    const double elapsed = std::chrono::duration<double>(now - m_rateTime).count();
+    for (auto& rate : m_rates) {
+      const auto count = rate.counter->value();
+      if (elapsed >= 1.) {
+        rate.rate  = (count - rate.count) / elapsed;
+        rate.count = count;
+      }
+      out << "# HELP " << rate.name << ' ' << rate.help << '\n';
+      out << "# TYPE " << rate.name << " gauge\n";
+      out << rate.name << '{' << rate.labels << part << "} " << rate.rate << '\n';
+    }
+    if (elapsed >= 1.) {
+      m_rateTime = now;
+    }
+    out << "# HELP k4marlinwrapper_resident_memory_bytes Resident set size of the process\n";
+    out << "# TYPE k4marlinwrapper_resident_memory_bytes gauge\n";
+    out << "k4marlinwrapper_resident_memory_bytes{" << partLabel << "} " << MemoryUsage::current().rss << '\n';
+
+    const auto  temporary = file + ".tmp";
+    std::FILE*  output    = std::fopen(temporary.c_str(), "w");
+    if (output == nullptr) {
+      return false;
+    }
+    const auto text = out.str();
+    const bool ok   = std::fwrite(text.data(), 1, text.size(), output) == text.size();
+    if (std::fclose(output) != 0 or not ok) {
+      std::remove(temporary.c_str());
+      return false;
+    }
+    return std::rename(temporary.c_str(), file.c_str()) == 0;
+  }
+
+private:
+  struct Series {
+    std::string      name;
+    std::string      help;
+    std::string      labels;
+    MetricCounter*   counter;
+    MetricHistogram* histogram;
+  };
+
+  struct Rate {
+    const MetricCounter* counter;
+    std::string          name;
+    std::string          help;
+    std::string          labels;
+    std::uint64_t        count;
+    double               rate;
+  };
+
+  static std::string seriesLabels(const std::string& component, const std::string& labels) {
+    const auto common = "component=\"" + component + "\"";
+    return labels.empty() ? common : labels + "," + common;
+  }
+
+  MetricsExporter() {
+    // the writer thread does not survive fork(), the child starts its own on first use
+    pthread_atfork(nullptr, nullptr, [] { instance().forgetThread(); });
+  }
+
+  void start() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_running) {
+      return;
+    }
+    m_stopping = false;
+    m_rateTime = std::chrono::steady_clock::now();
+    for (auto& rate : m_rates) {
+      rate.count = rate.counter->value();
+    }
+    m_thread    = std::thread([this] { run(); });
+    m_running.store(true, std::memory_order_release);
+  }
+
+  void run() {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while (not m_wakeUp.wait_for(lock, m_interval, [this] { return m_stopping; })) {
+      lock.unlock();
+      write();
+      lock.lock();
+    }
+  }
+
+  void forgetThread() {
+    // the handle refers to a thread of the parent, it can neither be joined nor destroyed
+    new (&m_thread) std::thread();
+    new (&m_mutex) std::mutex();
+    new (&m_wakeUp) std::condition_variable();
+    m_running.store(false, std::memory_order_release);
+  }
+
+  std::atomic<bool>           m_enabled{false};
+  std::atomic<bool>           m_running{false};
+  bool                        m_stopping = false;
+  std::mutex                  m_mutex;
+  std::condition_variable     m_wakeUp;
+  std::thread                 m_thread;
+  std::chrono::seconds        m_interval{10};
+  std::string                 m_file;
+  std::deque<MetricCounter>   m_counters;
+  std::deque<MetricHistogram> m_histograms;
+  std::vector<Series>         m_series;
+
+  std::vector<Rate>                     m_rates;
+  std::chrono::steady_clock::time_point m_rateTime;
+};
+
+}
+
+#endif
@@ -0,0 +1,142 @@
+#ifndef K4MARLINWRAPPER_PERFCOUNTERS_H
+#define K4MARLINWRAPPER_PERFCOUNTERS_H
+
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+#include <linux/perf_event.h>
+#include <pthread.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace k4MW::util {
+
+// perf_event_open counters of the calling thread, user space only. The hardware
+// counters form one group and the software counters another, so that a sample
+// takes two read() calls. Counters the kernel or the VM does not provide are
+// left out and read as zero; software counters are used as a fallback when no
+// hardware counter is available at all.
+class PerfCounters {
+public:
+  enum Counter { Cycles = 0, Instructions, CacheMisses, BranchMisses, PageFaults, TaskClock, ContextSwitches, NCounters };
+  using Values = std::array<std::uint64_t, NCounters>;
+
+  static const char* counterName(Counter counter) {
+    static constexpr std::array<const char*, NCounters> names = {
+        "cycles", "instructions", "cache_misses", "branch_misses", "page_faults", "task_clock", "context_switches"};
+    return names[counter];
+  }
+
+  // Counters of the calling thread, opened on first use and opened again after a fork:
+  // the descriptors inherited by a child process keep counting the thread of the parent
+  static PerfCounters& forThread() {
+    static const bool registered = [] { return pthread_atfork(nullptr, nullptr, [] { ++forkGeneration(); }) == 0; }();
+    thread_local std::unique_ptr<PerfCounters> counters;
+    thread_local unsigned                      generation = 0;
+    if (not counters or generation != forkGeneration()) {
+      counters.reset(new PerfCounters());
+      generation = forkGeneration();
+    }
+    (void)registered;
+    return *counters;
+  }
+
+  ~PerfCounters() {
+    for (const auto& group : m_groups) {
+      for (const auto& member : group.members) {
+        close(member.fd);
+      }
+    }
+  }
+
+  PerfCounters(const PerfCounters&) = delete;
+  PerfCounters& operator=(const PerfCounters&) = delete;
+
+  bool available(Counter counter) const { return m_available[counter]; }
+  bool hardware() const { return m_available[Cycles] or m_available[Instructions]; }
+
+  Values read() const {
+    Values values{};
+    for (const auto& group : m_groups) {
+      // layout of PERF_FORMAT_GROUP: number of counters, then one value per counter
+      std::array<std::uint64_t, NCounters + 1> buffer{};
+      if (::read(group.members.front().fd, buffer.data(), sizeof(buffer)) <= 0) {
+        continue;
+      }
+      for (std::size_t index = 0; index < group.members.size() and index < buffer[0]; ++index) {
+        values[group.members[index].counter] = buffer[index + 1];
+      }
+    }
+    return values;
+  }
+
+private:
+  // Number of forks this process went through
+  static unsigned& forkGeneration() {
+    static unsigned generation = 0;
+    return generation;
+  }
+
+  struct Member {
+    int     fd;
+    Counter counter;
+  };
+  struct Group {
+    std::vector<Member> members;
+  };
+
+  PerfCounters() {
+    openGroup({{PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES, Cycles},
+               {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS, Instructions},
+               {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES, CacheMisses},
+               {PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES, BranchMisses}});
+    openGroup({{PERF_TYPE_SOFTWARE, PERF_COUNT_SW_TASK_CLOCK, TaskClock},
+               {PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS, PageFaults},
+               {PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CONTEXT_SWITCHES, ContextSwitches}});
+  }
+
+  struct Event {
+    std::uint32_t type;
+    std::uint64_t config;
+    Counter       counter;
+  };
+
+  void openGroup(const std::vector<Event>& events) {
+    Group group;
+    for (const auto& event : events) {
+      perf_event_attr attr;
+      std::memset(&attr, 0, sizeof(attr));
+      attr.size           = sizeof(attr);
+      attr.type           = event.type;
+      attr.config         = event.config;
+      attr.read_format    = PERF_FORMAT_GROUP;
+      attr.exclude_kernel = 1;
+      attr.exclude_hv     = 1;
+      attr.disabled       = group.members.empty() ? 1 : 0;
+      const int leader    = group.members.empty() ? -1 : group.members.front().fd;
+      const int fd        = syscall(SYS_perf_event_open, &attr, 0, -1, leader, 0);
+      if (fd < 0) {
+        if (group.members.empty()) {
+          // without a leader the rest of the group cannot be opened either
+          return;
+        }
+        continue;
+      }
+      group.members.push_back({int(fd), event.counter});
+      m_available[event.counter] = true;
+    }
+    ioctl(group.members.front().fd, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+    m_groups.push_back(std::move(group));
+  }
+
+  std::vector<Group>          m_groups;
+  std::array<bool, NCounters> m_available{};
+};
+
+}
+
+#endif
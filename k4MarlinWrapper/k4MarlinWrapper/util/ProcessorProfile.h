@@ -0,0 +1,500 @@
+#ifndef K4MARLINWRAPPER_PROCESSORPROFILE_H
+#define K4MARLINWRAPPER_PROCESSORPROFILE_H
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include <time.h>
+
+#include "k4MarlinWrapper/util/MemoryUsage.h"
+#include "k4MarlinWrapper/util/PerfCounters.h"
+
+namespace k4MW::util {
+
+// Histogram of durations in nanoseconds with 16 logarithmic bins per factor
+// of two, at fixed memory however many events are recorded. A bin spans a
+// factor 2^(1/16), so percentiles are known to within up to about 4.4% per
+// bin, and about 6% in the worst case.
+class DurationHistogram {
+public:
+  void fill(std::uint64_t nanoseconds) {
+    ++m_bins[bin(nanoseconds)];
+    ++m_count;
+    m_total += nanoseconds;
+    m_max = std::max(m_max, nanoseconds);
+  }
+
+  std::uint64_t count() const { return m_count; }
+  std::uint64_t total() const { return m_total; }
+  std::uint64_t max() const { return m_max; }
+  double        mean() const { return m_count > 0 ? double(m_total) / m_count : 0.; }
+
+  // Upper edge of the bin containing the given fraction of the entries
+  std::uint64_t percentile(double fraction) const {
+    const auto    rank  = std::uint64_t(fraction * m_count + 0.5);
+    std::uint64_t below = 0;
+    for (std::size_t index = 0; index < NBins; ++index) {
+      below += m_bins[index];
+      if (below >= std::max<std::uint64_t>(rank, 1)) {
+        return std::min(upperEdge(index), m_max);
+      }
+    }
+    return m_max;
+  }
+
+private:
+  static constexpr int         SubBits = 4;
+  static constexpr std::size_t NBins   = (64 - SubBits + 1) << SubBits;
+
+  static std::size_t bin(std::uint64_t value) {
+    if (value < (1u << SubBits)) {
+      return value;
+    }
+    const int exponent = 63 - __builtin_clzll(value);
+    const int shift    = exponent - SubBits;
+    return (std::size_t(shift + 1) << SubBits) + ((value >> shift) & ((1u << SubBits) - 1));
+  }
+
+  static std::uint64_t upperEdge(std::size_t index) {
+    if (index < (1u << SubBits)) {
+      return index;
+    }
+    const int  shift = int(index >> SubBits) - 1;
+    const auto lower = ((1ull << SubBits) + (index & ((1u << SubBits) - 1))) << shift;
+    return lower + (1ull << shift) - 1;
+  }
+
+  std::array<std::uint64_t, NBins> m_bins{};
+  std::uint64_t                    m_count = 0;
+  std::uint64_t                    m_total = 0;
+  std::uint64_t                    m_max   = 0;
+};
+
+// Least squares fit of log(time) = log(prefactor) + exponent * log(size) over the
+// processor calls, from running sums so that no per-event data is kept. Calls
+// without input or with zero time cannot enter the logarithmic model.
+class ScalingFit {
+public:
+  void fill(std::uint64_t size, std::uint64_t nanoseconds) {
+    if (size == 0 or nanoseconds == 0) {
+      return;
+    }
+    const double x = std::log(double(size));
+    const double y = std::log(double(nanoseconds));
+    ++m_count;
+    m_sumSize += size;
+    m_sumX += x;
+    m_sumY += y;
+    m_sumXX += x * x;
+    m_sumXY += x * y;
+    m_sumYY += y * y;
+  }
+
+  std::uint64_t count() const { return m_count; }
+  double        meanSize() const { return m_count > 0 ? m_sumSize / m_count : 0.; }
+
+  // Enough calls with different input sizes to determine the exponent
+  bool valid() const { return m_count >= 10 and varianceX() > 1e-3; }
+
+  double exponent() const { return valid() ? covariance() / varianceX() : 0.; }
+  // Time in ns for an input of size 1
+  double prefactor() const { return valid() ? std::exp((m_sumY - exponent() * m_sumX) / m_count) : 0.; }
+  // Fraction of the variance of log(time) described by the model
+  double r2() const {
+    const double varianceY = m_sumYY / m_count - std::pow(m_sumY / m_count, 2);
+    return valid() and varianceY > 0 ? std::pow(covariance(), 2) / (varianceX() * varianceY) : 0.;
+  }
+
+private:
+  double varianceX() const { return m_count > 0 ? m_sumXX / m_count - std::pow(m_sumX / m_count, 2) : 0.; }
+  double covariance() const { return m_sumXY / m_count - (m_sumX / m_count) * (m_sumY / m_count); }
+
+  std::uint64_t m_count   = 0;
+  double        m_sumSize = 0;
+  double        m_sumX    = 0;
+  double        m_sumY    = 0;
+  double        m_sumXX   = 0;
+  double        m_sumXY   = 0;
+  double        m_sumYY   = 0;
+};
+
+// Wall and CPU time spent by one wrapped processor, split into the conversion
+// of its inputs, the processor call and the conversion of its outputs.
+class ProcessorProfile {
+public:
+  enum Stage { EDM4hepToLCIO = 0, Process, LCIOToEDM4hep, NStages };
+
+  static const char* stageName(Stage stage) {
+    static constexpr std::array<const char*, NStages> names = {"EDM4hep2LCIO", "Process", "LCIO2EDM4hep"};
+    return names[stage];
+  }
+
+  // Measures the wall and thread CPU time of a scope, the perf counters of the processor
+  // call and the memory growth if they are enabled; does nothing without a profile
+  class Timer {
+  public:
+    Timer(ProcessorProfile* profile, Stage stage)
+        : m_profile(profile),
+          m_stage(stage),
+          m_counters(profile != nullptr and profile->m_hasCounters and stage == Process) {
+      if (m_profile != nullptr) {
+        if (m_profile->m_hasMemory) {
+          m_memoryStart = MemoryUsage::current();
+        }
+        if (m_counters) {
+          m_countersStart = PerfCounters::forThread().read();
+        }
+        m_wall = std::chrono::steady_clock::now();
+        m_cpu  = threadCpuTime();
+      }
+    }
+    ~Timer() {
+      if (m_profile != nullptr) {
+        const auto wall = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - m_wall);
+        const auto cpu  = threadCpuTime() - m_cpu;
+        PerfCounters::Values counters{};
+        if (m_counters) {
+          const auto end = PerfCounters::forThread().read();
+          for (int counter = 0; counter < PerfCounters::NCounters; ++counter) {
+            counters[counter] = end[counter] - m_countersStart[counter];
+          }
+        }
+        MemoryUsage memory;
+        if (m_profile->m_hasMemory) {
+          memory = MemoryUsage::current() - m_memoryStart;
+        }
+        m_profile->record(m_stage, wall.count(), cpu, counters, memory, m_inputSize);
+      }
+    }
+
+    Timer(const Timer&) = delete;
+    Timer& operator=(const Timer&) = delete;
+
+    // Number of elements in the input collections of the call, for the scaling fit
+    void setInputSize(std::uint64_t size) { m_inputSize = size; }
+
+  private:
+    ProcessorProfile*                     m_profile;
+    Stage                                 m_stage;
+    bool                                  m_counters;
+    std::chrono::steady_clock::time_point m_wall;
+    std::uint64_t                         m_cpu = 0;
+    PerfCounters::Values                  m_countersStart{};
+    MemoryUsage                           m_memoryStart;
+    std::int64_t                          m_inputSize = -1;
+  };
+
+  ProcessorProfile(std::string name, std::string type) : m_name(std::move(name)), m_type(std::move(type)) {}
+
+  // Count cycles, instructions, cache and branch misses and page faults of the processor calls
+  void enableCounters() { m_hasCounters = true; }
+  bool hasCounters() const { return m_hasCounters; }
+
+  // Attribute the growth of the resident set and the heap to the stages
+  void enableMemory() { m_hasMemory = true; }
+  bool hasMemory() const { return m_hasMemory; }
+
+  // Fit the time of the processor calls against their input size, exponents above
+  // superlinearExponent are flagged in the report
+  void enableScaling(double superlinearExponent) {
+    m_hasScaling          = true;
+    m_superlinearExponent = superlinearExponent;
+  }
+  bool hasScaling() const { return m_hasScaling; }
+
+  void record(Stage stage, std::uint64_t wallNanoseconds, std::uint64_t cpuNanoseconds,
+              const PerfCounters::Values& counters = {}, const MemoryUsage& memory = {}, std::int64_t inputSize = -1) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_wall[stage].fill(wallNanoseconds);
+    m_cpu[stage].fill(cpuNanoseconds);
+    for (int counter = 0; counter < PerfCounters::NCounters; ++counter) {
+      m_counters[counter] += counters[counter];
+    }
+    m_memory[stage] += memory;
+    if (inputSize >= 0) {
+      m_scaling.fill(inputSize, wallNanoseconds);
+    }
+  }
+
+  const std::string&       name() const { return m_name; }
+  const std::string&       type() const { return m_type; }
+  const DurationHistogram& wall(Stage stage) const { return m_wall[stage]; }
+  const DurationHistogram& cpu(Stage stage) const { return m_cpu[stage]; }
+  std::uint64_t counter(PerfCounters::Counter counter) const { return m_counters[counter]; }
+  // Sum of the memory growth over all calls of a stage, negative if memory was freed
+  const MemoryUsage& memoryGrowth(Stage stage) const { return m_memory[stage]; }
+
+  const ScalingFit& scaling() const { return m_scaling; }
+  bool superlinear() const { return m_scaling.valid() and m_scaling.exponent() > m_superlinearExponent; }
+
+  MemoryUsage totalMemoryGrowth() const {
+    MemoryUsage total;
+    for (const auto& memory : m_memory) {
+      total += memory;
+    }
+    return total;
+  }
+
+  std::uint64_t totalWall() const {
+    std::uint64_t total = 0;
+    for (const auto& histogram : m_wall) {
+      total += histogram.total();
+    }
+    return total;
+  }
+
+private:
+  static std::uint64_t threadCpuTime() {
+    timespec now{};
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now);
+    return std::uint64_t(now.tv_sec) * 1000000000ull + now.tv_nsec;
+  }
+
+  std::string                            m_name;
+  std::string                            m_type;
+  std::mutex                             m_mutex;
+  std::array<DurationHistogram, NStages> m_wall;
+  std::array<DurationHistogram, NStages> m_cpu;
+  bool                                   m_hasCounters = false;
+  PerfCounters::Values                   m_counters{};
+  bool                                   m_hasMemory = false;
+  std::array<MemoryUsage, NStages>       m_memory{};
+  bool                                   m_hasScaling          = false;
+  double                                 m_superlinearExponent = 0;
+  ScalingFit                             m_scaling;
+};
+
+using ProcessorProfiles = std::vector<std::shared_ptr<ProcessorProfile>>;
+
+// Profiles ordered by the total wall time, most expensive first
+inline ProcessorProfiles sortedProfiles(ProcessorProfiles profiles) {
+  std::stable_sort(profiles.begin(), profiles.end(),
+                   [](const auto& lhs, const auto& rhs) { return lhs->totalWall() > rhs->totalWall(); });
+  return profiles;
+}
+
+// Table of the stages of all processors, times in milliseconds unless noted
+inline void writeProfileTable(std::ostream& out, const ProcessorProfiles& profiles) {
+  const auto ms = [](double nanoseconds) { return nanoseconds * 1e-6; };
+  std::size_t width = 9;
+  for (const auto& profile : profiles) {
+    width = std::max(width, profile->name().size());
+  }
+
+  out << std::left << std::setw(width) << "Processor" << std::right << std::setw(14) << "Stage" << std::setw(9)
+      << "Calls" << std::setw(11) << "Wall[s]" << std::setw(11) << "CPU[s]" << std::setw(10) << "Mean" << std::setw(10)
+      << "p50" << std::setw(10) << "p95" << std::setw(10) << "p99" << std::setw(10) << "Max" << '\n';
+  out << std::fixed;
+  for (const auto& profile : sortedProfiles(profiles)) {
+    for (int index = 0; index < ProcessorProfile::NStages; ++index) {
+      const auto  stage = ProcessorProfile::Stage(index);
+      const auto& wall  = profile->wall(stage);
+      if (wall.count() == 0) {
+        continue;
+      }
+      out << std::left << std::setw(width) << profile->name() << std::right << std::setw(14)
+          << ProcessorProfile::stageName(stage) << std::setw(9) << wall.count() << std::setprecision(3) << std::setw(11)
+          << wall.total() * 1e-9 << std::setw(11) << profile->cpu(stage).total() * 1e-9 << std::setw(10)
+          << ms(wall.mean()) << std::setw(10) << ms(wall.percentile(0.5)) << std::setw(10) << ms(wall.percentile(0.95))
+          << std::setw(10) << ms(wall.percentile(0.99)) << std::setw(10) << ms(wall.max()) << '\n';
+    }
+  }
+  out << std::defaultfloat;
+}
+
+// Rates derived from the perf counters of the processor calls of the profiles that count them.
+// Counters that are not available on this machine are shown as n/a.
+inline void writeCounterTable(std::ostream& out, const ProcessorProfiles& profiles) {
+  const auto& perf  = PerfCounters::forThread();
+  std::size_t width = 9;
+  for (const auto& profile : profiles) {
+    width = std::max(width, profile->name().size());
+  }
+  const auto column = [&out](bool available, double value) {
+    if (available) {
+      out << std::setw(12) << value;
+    } else {
+      out << std::setw(12) << "n/a";
+    }
+  };
+
+  out << std::left << std::setw(width) << "Processor" << std::right << std::setw(9) << "Calls" << std::setw(12) << "IPC"
+      << std::setw(12) << "Cache MPKI" << std::setw(12) << "Branch MPKI" << std::setw(12) << "Faults/call"
+      << std::setw(12) << "CtxSw/call" << std::setw(12) << "CPU[s]" << '\n';
+  out << std::fixed << std::setprecision(3);
+  for (const auto& profile : sortedProfiles(profiles)) {
+    if (not profile->hasCounters()) {
+      continue;
+    }
+    const auto calls        = std::max<std::uint64_t>(profile->wall(ProcessorProfile::Process).count(), 1);
+    const auto cycles       = double(profile->counter(PerfCounters::Cycles));
+    const auto instructions = double(profile->counter(PerfCounters::Instructions));
+    const auto kiloInstr    = std::max(instructions * 1e-3, 1e-9);
+    out << std::left << std::setw(width) << profile->name() << std::right << std::setw(9)
+        << profile->wall(ProcessorProfile::Process).count();
+    column(perf.available(PerfCounters::Cycles) and perf.available(PerfCounters::Instructions),
+           cycles > 0 ? instructions / cycles : 0.);
+    column(perf.available(PerfCounters::CacheMisses) and perf.available(PerfCounters::Instructions),
+           profile->counter(PerfCounters::CacheMisses) / kiloInstr);
+    column(perf.available(PerfCounters::BranchMisses) and perf.available(PerfCounters::Instructions),
+           profile->counter(PerfCounters::BranchMisses) / kiloInstr);
+    column(perf.available(PerfCounters::PageFaults), double(profile->counter(PerfCounters::PageFaults)) / calls);
+    column(perf.available(PerfCounters::ContextSwitches),
+           double(profile->counter(PerfCounters::ContextSwitches)) / calls);
+    column(perf.available(PerfCounters::TaskClock), profile->counter(PerfCounters::TaskClock) * 1e-9);
+    out << '\n';
+  }
+  out << std::defaultfloat;
+}
+
+// Memory growth of the profiles that track it, in MB, largest heap growth first
+inline void writeMemoryTable(std::ostream& out, const ProcessorProfiles& profiles) {
+  std::size_t width = 9;
+  for (const auto& profile : profiles) {
+    width = std::max(width, profile->name().size());
+  }
+  auto sorted = profiles;
+  std::stable_sort(sorted.begin(), sorted.end(), [](const auto& lhs, const auto& rhs) {
+    return lhs->totalMemoryGrowth().heap > rhs->totalMemoryGrowth().heap;
+  });
+
+  const auto mb = [](std::int64_t bytes) { return bytes / (1024. * 1024.); };
+  out << std::left << std::setw(width) << "Processor" << std::right << std::setw(9) << "Calls" << std::setw(14)
+      << "Heap convert" << std::setw(14) << "Heap process" << std::setw(14) << "RSS convert" << std::setw(14)
+      << "RSS process" << std::setw(14) << "Heap kB/call" << '\n';
+  out << std::fixed << std::setprecision(3);
+  for (const auto& profile : sorted) {
+    if (not profile->hasMemory()) {
+      continue;
+    }
+    const auto& process = profile->memoryGrowth(ProcessorProfile::Process);
+    auto        convert = profile->memoryGrowth(ProcessorProfile::EDM4hepToLCIO);
+    convert += profile->memoryGrowth(ProcessorProfile::LCIOToEDM4hep);
+    const auto calls = std::max<std::uint64_t>(profile->wall(ProcessorProfile::Process).count(), 1);
+    out << std::left << std::setw(width) << profile->name() << std::right << std::setw(9)
+        << profile->wall(ProcessorProfile::Process).count() << std::setw(14) << mb(convert.heap) << std::setw(14)
+        << mb(process.heap) << std::setw(14) << mb(convert.rss) << std::setw(14) << mb(process.rss) << std::setw(14)
+        << profile->totalMemoryGrowth().heap / 1024. / calls << '\n';
+  }
+  out << std::defaultfloat;
+}
+
+// Scaling of the processor time with the input size, steepest first
+inline void writeScalingTable(std::ostream& out, const ProcessorProfiles& profiles) {
+  std::size_t width = 9;
+  for (const auto& profile : profiles) {
+    width = std::max(width, profile->name().size());
+  }
+  auto sorted = profiles;
+  std::stable_sort(sorted.begin(), sorted.end(), [](const auto& lhs, const auto& rhs) {
+    return lhs->scaling().exponent() > rhs->scaling().exponent();
+  });
+
+  out << std::left << std::setw(width) << "Processor" << std::right << std::setw(9) << "Events" << std::setw(12)
+      << "Mean size" << std::setw(10) << "Exponent" << std::setw(8) << "R2" << std::setw(14) << "ms at mean" << '\n';
+  out << std::fixed;
+  for (const auto& profile : sorted) {
+    if (not profile->hasScaling()) {
+      continue;
+    }
+    const auto& fit = profile->scaling();
+    out << std::left << std::setw(width) << profile->name() << std::right << std::setw(9) << fit.count()
+        << std::setprecision(1) << std::setw(12) << fit.meanSize();
+    if (fit.valid()) {
+      out << std::setprecision(2) << std::setw(10) << fit.exponent() << std::setw(8) << fit.r2()
+          << std::setprecision(3) << std::setw(14) << fit.prefactor() * std::pow(fit.meanSize(), fit.exponent()) * 1e-6
+          << (profile->superlinear() ? "  superlinear" : "");
+    } else {
+      out << std::setw(10) << "n/a" << std::setw(8) << "n/a" << std::setw(14) << "n/a";
+    }
+    out << '\n';
+  }
+  out << std::defaultfloat;
+}
+
+// One line per processor and stage, times in nanoseconds, memory in bytes
+inline void writeProfileCsv(std::ostream& out, const ProcessorProfiles& profiles) {
+  out << "processor,type,stage,calls,wall_total,cpu_total,wall_mean,wall_p50,wall_p95,wall_p99,wall_max";
+  for (int counter = 0; counter < PerfCounters::NCounters; ++counter) {
+    out << ',' << PerfCounters::counterName(PerfCounters::Counter(counter));
+  }
+  out << ",heap_growth,rss_growth,scaling_exponent,scaling_r2\n";
+  for (const auto& profile : sortedProfiles(profiles)) {
+    for (int index = 0; index < ProcessorProfile::NStages; ++index) {
+      const auto  stage = ProcessorProfile::Stage(index);
+      const auto& wall  = profile->wall(stage);
+      out << profile->name() << ',' << profile->type() << ',' << ProcessorProfile::stageName(stage) << ','
+          << wall.count() << ',' << wall.total() << ',' << profile->cpu(stage).total() << ','
+          << std::uint64_t(wall.mean()) << ',' << wall.percentile(0.5) << ',' << wall.percentile(0.95) << ','
+          << wall.percentile(0.99) << ',' << wall.max();
+      // the counters are only taken around the processor call
+      for (int counter = 0; counter < PerfCounters::NCounters; ++counter) {
+        out << ',' << (stage == ProcessorProfile::Process ? profile->counter(PerfCounters::Counter(counter)) : 0);
+      }
+      out << ',' << profile->memoryGrowth(stage).heap << ',' << profile->memoryGrowth(stage).rss;
+      const bool fitted = stage == ProcessorProfile::Process and profile->scaling().valid();
+      out << ',' << (fitted ? profile->scaling().exponent() : 0.) << ',' << (fitted ? profile->scaling().r2() : 0.)
+          << '\n';
+    }
+  }
+}
+
+// Same content as the CSV, as a list of processors with their stages
+inline void writeProfileJson(std::ostream& out, const ProcessorProfiles& profiles) {
+  out << "{\n  \"unit\": \"ns\",\n  \"memory_unit\": \"bytes\",\n  \"processors\": [";
+  const char* separator = "\n";
+  for (const auto& profile : sortedProfiles(profiles)) {
+    out << separator << "    {\"name\": \"" << profile->name() << "\", \"type\": \"" << profile->type()
+        << "\", \"stages\": {";
+    for (int index = 0; index < ProcessorProfile::NStages; ++index) {
+      const auto  stage = ProcessorProfile::Stage(index);
+      const auto& wall  = profile->wall(stage);
+      out << (index > 0 ? ", " : "") << '"' << ProcessorProfile::stageName(stage) << "\": {\"calls\": " << wall.count()
+          << ", \"wall_total\": " << wall.total() << ", \"cpu_total\": " << profile->cpu(stage).total()
+          << ", \"wall_mean\": " << std::uint64_t(wall.mean()) << ", \"wall_p50\": " << wall.percentile(0.5)
+          << ", \"wall_p95\": " << wall.percentile(0.95) << ", \"wall_p99\": " << wall.percentile(0.99)
+          << ", \"wall_max\": " << wall.max();
+      if (profile->hasMemory()) {
+        out << ", \"heap_growth\": " << profile->memoryGrowth(stage).heap
+            << ", \"rss_growth\": " << profile->memoryGrowth(stage).rss;
+      }
+      out << "}";
+    }
+    out << "}";
+    if (profile->hasCounters()) {
+      out << ", \"counters\": {";
+      const char* counterSeparator = "";
+      for (int counter = 0; counter < PerfCounters::NCounters; ++counter) {
+        const auto perfCounter = PerfCounters::Counter(counter);
+        if (PerfCounters::forThread().available(perfCounter)) {
+          out << counterSeparator << '"' << PerfCounters::counterName(perfCounter)
+              << "\": " << profile->counter(perfCounter);
+          counterSeparator = ", ";
+        }
+      }
+      out << "}";
+    }
+    if (profile->hasScaling() and profile->scaling().valid()) {
+      const auto& fit = profile->scaling();
+      out << ", \"scaling\": {\"events\": " << fit.count() << ", \"mean_size\": " << fit.meanSize()
+          << ", \"exponent\": " << fit.exponent() << ", \"prefactor\": " << fit.prefactor() << ", \"r2\": " << fit.r2()
+          << ", \"superlinear\": " << (profile->superlinear() ? "true" : "false") << "}";
+    }
+    out << "}";
+    separator = ",\n";
+  }
+  out << "\n  ]\n}\n";
+}
+
+}
+
+#endif
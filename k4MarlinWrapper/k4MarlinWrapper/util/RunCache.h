@@ -0,0 +1,59 @@
+#ifndef K4MARLINWRAPPER_RUNCACHE_H
+#define K4MARLINWRAPPER_RUNCACHE_H
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <typeindex>
+#include <utility>
+
+namespace k4MW::util {
+
+// Values computed once per run, e.g. calibration constants or lookup tables that
+// depend on the run conditions. A new cache is made for every run, so nothing has
+// to be invalidated: the values of a run are released once its last event is done.
+// Converters get the cache of the event from the run header in the event store,
+// Marlin processors from current() during processRunHeader and processEvent.
+class RunCache {
+public:
+  explicit RunCache(int run) : m_run(run) {}
+
+  RunCache(const RunCache&) = delete;
+  RunCache& operator=(const RunCache&) = delete;
+
+  int run() const { return m_run; }
+
+  // Value stored under key, made by make() the first time it is asked for in this run
+  template <class T, class Make> T& get(const std::string& key, Make&& make) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto                        entry = m_values.find(key);
+    if (entry == m_values.end()) {
+      entry = m_values.emplace(key, Entry{typeid(T), std::make_shared<T>(make())}).first;
+    } else if (entry->second.type != std::type_index(typeid(T))) {
+      throw std::logic_error("RunCache: " + key + " holds another type");
+    }
+    return *static_cast<T*>(entry->second.value.get());
+  }
+
+  // Cache of the run of the event a processor of this thread is working on, nullptr outside
+  static RunCache*& current() {
+    thread_local RunCache* cache = nullptr;
+    return cache;
+  }
+
+private:
+  struct Entry {
+    std::type_index       type;
+    std::shared_ptr<void> value;
+  };
+
+  int                          m_run;
+  std::mutex                   m_mutex;
+  std::map<std::string, Entry> m_values;
+};
+
+}
+
+#endif
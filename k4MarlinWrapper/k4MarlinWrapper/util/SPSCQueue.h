@@ -0,0 +1,106 @@
+#ifndef K4MARLINWRAPPER_SPSCQUEUE_H
+#define K4MARLINWRAPPER_SPSCQUEUE_H
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <thread>
+#include <vector>
+
+namespace k4MW::util {
+
+// Lock-free ring buffer for exactly one producer and one consumer thread.
+// tryPush()/tryPop() never block; push()/pop() retry with a short backoff
+// so that a stalled side does not burn a full core while it waits.
+// After close() no new items are accepted and pop() drains what is left.
+template <typename T>
+class SPSCQueue {
+public:
+  explicit SPSCQueue(std::size_t capacity) : m_slots(std::max<std::size_t>(capacity, 1) + 1) {}
+
+  SPSCQueue(const SPSCQueue&) = delete;
+  SPSCQueue& operator=(const SPSCQueue&) = delete;
+
+  // Moves from item only on success
+  bool tryPush(T& item) {
+    const auto tail = m_tail.load(std::memory_order_relaxed);
+    const auto next = increment(tail);
+    if (next == m_head.load(std::memory_order_acquire)) {
+      return false;
+    }
+    m_slots[tail] = std::move(item);
+    m_tail.store(next, std::memory_order_release);
+    return true;
+  }
+
+  bool tryPop(T& item) {
+    const auto head = m_head.load(std::memory_order_relaxed);
+    if (head == m_tail.load(std::memory_order_acquire)) {
+      return false;
+    }
+    item = std::move(m_slots[head]);
+    m_head.store(increment(head), std::memory_order_release);
+    return true;
+  }
+
+  // Returns false if the queue was closed before the item could be queued
+  bool push(T item) {
+    Backoff backoff;
+    while (not tryPush(item)) {
+      if (closed()) {
+        return false;
+      }
+      backoff.wait();
+    }
+    return true;
+  }
+
+  // Returns false once the queue is closed and empty
+  bool pop(T& item) {
+    Backoff backoff;
+    while (not tryPop(item)) {
+      if (closed()) {
+        // the producer may have pushed right before closing
+        return tryPop(item);
+      }
+      backoff.wait();
+    }
+    return true;
+  }
+
+  void close() { m_closed.store(true, std::memory_order_release); }
+  bool closed() const { return m_closed.load(std::memory_order_acquire); }
+
+private:
+  // Spin a few times, then yield, then sleep for increasing intervals up to 1 ms
+  class Backoff {
+  public:
+    void wait() {
+      if (m_count < 64) {
+        ++m_count;
+      } else if (m_count < 128) {
+        ++m_count;
+        std::this_thread::yield();
+      } else {
+        std::this_thread::sleep_for(m_sleep);
+        m_sleep = std::min(m_sleep * 2, std::chrono::microseconds(1000));
+      }
+    }
+
+  private:
+    unsigned                  m_count = 0;
+    std::chrono::microseconds m_sleep{10};
+  };
+
+  std::size_t increment(std::size_t index) const { return (index + 1) % m_slots.size(); }
+
+  std::vector<T>                       m_slots;
+  alignas(64) std::atomic<std::size_t> m_head{0};
+  alignas(64) std::atomic<std::size_t> m_tail{0};
+  std::atomic<bool>                    m_closed{false};
+};
+
+}
+
+#endif
@@ -0,0 +1,43 @@
+#ifndef K4MARLINWRAPPER_SHAREDCHUNKCOUNTER_H
+#define K4MARLINWRAPPER_SHAREDCHUNKCOUNTER_H
+
+#include <atomic>
+#include <cstddef>
+#include <new>
+
+#include <sys/mman.h>
+
+#include "k4MarlinWrapper/util/ChunkCounter.h"
+
+namespace k4MW::util {
+
+// Counter of event chunks handed out to the worker processes of a job.
+// Lives in an anonymous shared mapping created before fork(), so that all
+// processes claim chunks from the same counter without further locking.
+class SharedChunkCounter : public ChunkCounter {
+public:
+  SharedChunkCounter() {
+    void* memory = mmap(nullptr, sizeof(std::atomic<std::size_t>), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS,
+                        -1, 0);
+    if (memory == MAP_FAILED) {
+      throw std::bad_alloc();
+    }
+    m_next = new (memory) std::atomic<std::size_t>(0);
+  }
+
+  ~SharedChunkCounter() override { munmap(m_next, sizeof(std::atomic<std::size_t>)); }
+
+  SharedChunkCounter(const SharedChunkCounter&) = delete;
+  SharedChunkCounter& operator=(const SharedChunkCounter&) = delete;
+
+  static_assert(std::atomic<std::size_t>::is_always_lock_free, "counter must be usable across processes");
+
+  std::size_t claim() override { return m_next->fetch_add(1, std::memory_order_relaxed); }
+
+private:
+  std::atomic<std::size_t>* m_next = nullptr;
+};
+
+}
+
+#endif
@@ -0,0 +1,147 @@
+#ifndef K4MARLINWRAPPER_STARTUPPROFILE_H
+#define K4MARLINWRAPPER_STARTUPPROFILE_H
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <iomanip>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <unistd.h>
+
+namespace k4MW::util {
+
+// Wall time of the phases of the job startup: the time before the first processor
+// wrapper is initialized, which includes reading the Python options, and per
+// processor the library loading, parameter parsing, instantiation, init() and the
+// conversion tools. Phases may be added from several threads; phases that overlap
+// with others, like processor inits on a thread pool, are not part of the sum.
+class StartupProfile {
+public:
+  struct Phase {
+    std::string phase;
+    std::string component;
+    double      seconds;
+    bool        concurrent = false;
+  };
+
+  // Adds the wall time of its lifetime as a phase
+  class Timer {
+  public:
+    Timer(StartupProfile& profile, std::string phase, std::string component, bool concurrent = false)
+        : m_profile(profile),
+          m_phase(std::move(phase)),
+          m_component(std::move(component)),
+          m_concurrent(concurrent),
+          m_start(std::chrono::steady_clock::now()) {}
+    ~Timer() {
+      m_profile.add(m_phase, m_component,
+                    std::chrono::duration<double>(std::chrono::steady_clock::now() - m_start).count(), m_concurrent);
+    }
+
+    Timer(const Timer&) = delete;
+    Timer& operator=(const Timer&) = delete;
+
+  private:
+    StartupProfile&                       m_profile;
+    std::string                           m_phase;
+    std::string                           m_component;
+    bool                                  m_concurrent;
+    std::chrono::steady_clock::time_point m_start;
+  };
+
+  void add(const std::string& phase, const std::string& component, double seconds, bool concurrent = false) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_phases.push_back({phase, component, seconds, concurrent});
+  }
+
+  // Wall time of the phases that did not overlap with others
+  double sequentialSeconds() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    double                      seconds = 0;
+    for (const auto& phase : m_phases) {
+      seconds += phase.concurrent ? 0 : phase.seconds;
+    }
+    return seconds;
+  }
+
+  // Phases with the longest first
+  std::vector<Phase> sorted() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto                        phases = m_phases;
+    std::stable_sort(phases.begin(), phases.end(),
+                     [](const auto& lhs, const auto& rhs) { return lhs.seconds > rhs.seconds; });
+    return phases;
+  }
+
+  // Seconds since the process was started, from the start time in /proc/self/stat, -1 if unknown
+  static double secondsSinceProcessStart() {
+    double     uptime = 0;
+    std::FILE* file   = std::fopen("/proc/uptime", "r");
+    const bool ok     = file != nullptr and std::fscanf(file, "%lf", &uptime) == 1;
+    if (file != nullptr) {
+      std::fclose(file);
+    }
+    file = std::fopen("/proc/self/stat", "r");
+    if (not ok or file == nullptr) {
+      if (file != nullptr) {
+        std::fclose(file);
+      }
+      return -1;
+    }
+    // the command in the second field may contain spaces, the fields after it are counted from its ')'
+    char       buffer[1024];
+    const auto size = std::fread(buffer, 1, sizeof(buffer) - 1, file);
+    std::fclose(file);
+    buffer[size]                   = '\0';
+    const char*        fields      = std::strrchr(buffer, ')');
+    unsigned long long start       = 0;
+    // starttime is the 22nd field, the 3rd is the state after the ')'
+    const char* const  startFormat = "%*c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u %*u %*u %*d %*d %*d %*d %*d %*d %llu";
+    if (fields == nullptr or std::sscanf(fields + 2, startFormat, &start) != 1) {
+      return -1;
+    }
+    return uptime - double(start) / sysconf(_SC_CLK_TCK);
+  }
+
+private:
+  mutable std::mutex m_mutex;
+  std::vector<Phase> m_phases;
+};
+
+// Table of the phases, longest first, with their share of the total startup time
+inline void writeStartupTable(std::ostream& out, const StartupProfile& profile, double totalSeconds) {
+  const auto flags     = out.flags();
+  const auto precision = out.precision();
+  out << std::left << std::setw(28) << "Phase" << std::setw(40) << "Component" << std::right << std::setw(10) << "s"
+      << std::setw(8) << "%" << '\n';
+  for (const auto& phase : profile.sorted()) {
+    out << std::left << std::setw(28) << phase.phase << std::setw(40) << phase.component << std::right << std::fixed
+        << std::setprecision(3) << std::setw(10) << phase.seconds << std::setprecision(1) << std::setw(8)
+        << (totalSeconds > 0 ? 100 * phase.seconds / totalSeconds : 0.) << '\n';
+  }
+  out << std::left << std::setw(68) << "Total" << std::right << std::setprecision(3) << std::setw(10) << totalSeconds
+      << '\n';
+  out.flags(flags);
+  out.precision(precision);
+}
+
+inline void writeStartupJson(std::ostream& out, const StartupProfile& profile, double totalSeconds) {
+  out << "{\n  \"unit\": \"s\",\n  \"total\": " << totalSeconds << ",\n  \"phases\": [";
+  const char* separator = "\n";
+  for (const auto& phase : profile.sorted()) {
+    out << separator << "    {\"phase\": \"" << phase.phase << "\", \"component\": \"" << phase.component
+        << "\", \"seconds\": " << phase.seconds << ", \"concurrent\": " << (phase.concurrent ? "true" : "false") << "}";
+    separator = ",\n";
+  }
+  out << "\n  ]\n}\n";
+}
+
+}
+
+#endif
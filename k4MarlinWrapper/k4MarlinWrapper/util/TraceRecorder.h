@@ -0,0 +1,186 @@
+#ifndef K4MARLINWRAPPER_TRACERECORDER_H
+#define K4MARLINWRAPPER_TRACERECORDER_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <set>
+#include <string>
+#include <vector>
+
+#include <pthread.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "k4MarlinWrapper/util/k4MarlinWrapperUtil.h"
+
+namespace k4MW::util {
+
+// Records begin/end spans of reading, conversions and processor calls and
+// writes them as a Chrome trace, to be opened in chrome://tracing or
+// ui.perfetto.dev. Every thread appends to its own buffer, so recording
+// takes no lock; the buffers are only read once the event loop is over.
+class TraceRecorder {
+public:
+  struct Span {
+    const char*   name;
+    const char*   category;
+    std::uint64_t begin;
+    std::uint64_t end;
+    int           run;
+    int           event;
+    long          slot;
+  };
+
+  // Records a span from construction to destruction while tracing is enabled
+  class Scope {
+  public:
+    Scope(const char* name, const char* category, long slot = -1) : m_span{name, category, 0, 0, -1, -1, slot} {
+      if (instance().enabled()) {
+        m_span.begin = now();
+      }
+    }
+    ~Scope() {
+      if (m_span.begin != 0) {
+        m_span.end = now();
+        instance().record(m_span);
+      }
+    }
+
+    Scope(const Scope&) = delete;
+    Scope& operator=(const Scope&) = delete;
+
+    void setEvent(int run, int event) {
+      m_span.run   = run;
+      m_span.event = event;
+    }
+
+  private:
+    Span m_span;
+  };
+
+  // One recorder for LcioEvent and the processor wrappers, defined in the k4MarlinWrapperUtil library
+  static TraceRecorder& instance();
+
+  void enable(const std::string& file) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_file = file;
+    m_enabled.store(true, std::memory_order_release);
+  }
+
+  bool enabled() const { return m_enabled.load(std::memory_order_relaxed); }
+
+  // Trace file of this process, tagged like the other outputs of a split job
+  std::string file() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return taggedFileName(m_file, outputTag());
+  }
+
+  // Span names must outlive the recorder, names built at run time are kept here
+  const char* intern(const std::string& name) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_names.insert(name).first->c_str();
+  }
+
+  void record(const Span& span) { buffer().spans.push_back(span); }
+
+  // Append the spans recorded so far to the trace file, tagged like the other outputs of
+  // a split job, and forget them. The first call in a process replaces an existing file.
+  bool write() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    const auto                  file   = taggedFileName(m_file, outputTag());
+    const bool                  append = file == m_written;
+
+    std::size_t nSpans = 0;
+    for (const auto& threadBuffer : m_buffers) {
+      nSpans += threadBuffer->spans.size();
+    }
+    if (append and nSpans == 0) {
+      return true;
+    }
+
+    std::FILE* out = std::fopen(file.c_str(), append ? "r+" : "w");
+    if (out == nullptr) {
+      return false;
+    }
+    if (append) {
+      // replace the closing bracket written last time
+      std::fseek(out, -2, SEEK_END);
+    } else {
+      std::fputs("[", out);
+      m_writtenSpans = false;
+    }
+    const char* separator = m_writtenSpans ? ",\n" : "\n";
+    const auto  pid       = getpid();
+    for (auto& threadBuffer : m_buffers) {
+      for (const auto& span : threadBuffer->spans) {
+        std::fprintf(out, "%s{\"name\": \"%s\", \"cat\": \"%s\", \"ph\": \"X\", \"ts\": %.3f, \"dur\": %.3f, ", separator,
+                     span.name, span.category, span.begin * 1e-3, (span.end - span.begin) * 1e-3);
+        std::fprintf(out, "\"pid\": %d, \"tid\": %ld, \"args\": {\"run\": %d, \"event\": %d, \"slot\": %ld}}",
+                     int(pid), threadBuffer->thread, span.run, span.event, span.slot);
+        separator      = ",\n";
+        m_writtenSpans = true;
+      }
+      threadBuffer->spans.clear();
+    }
+    std::fputs("\n]", out);
+    const bool ok = std::fclose(out) == 0;
+    m_written     = file;
+    return ok;
+  }
+
+private:
+  struct ThreadBuffer {
+    long             thread;
+    std::deque<Span> spans;
+  };
+
+  TraceRecorder() {
+    // a forked worker starts with the buffer of the forking thread only, its spans are written by the parent
+    pthread_atfork(nullptr, nullptr, [] { instance().restartAfterFork(); });
+  }
+
+  void restartAfterFork() {
+    new (&m_mutex) std::mutex();
+    for (auto& threadBuffer : m_buffers) {
+      threadBuffer->spans.clear();
+    }
+    buffer().thread = syscall(SYS_gettid);
+    m_written.clear();
+  }
+
+  static std::uint64_t now() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+  }
+
+  ThreadBuffer& buffer() {
+    thread_local ThreadBuffer* threadBuffer = nullptr;
+    if (threadBuffer == nullptr) {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_buffers.push_back(std::make_unique<ThreadBuffer>());
+      threadBuffer         = m_buffers.back().get();
+      threadBuffer->thread = syscall(SYS_gettid);
+    }
+    return *threadBuffer;
+  }
+
+  std::atomic<bool>                          m_enabled{false};
+  std::mutex                                 m_mutex;
+  std::string                                m_file;
+  /// File written by this process, later writes append to it
+  std::string                                m_written;
+  /// Whether the written file holds a span, the next ones are appended after a comma
+  bool                                       m_writtenSpans = false;
+  std::set<std::string>                      m_names;
+  std::vector<std::unique_ptr<ThreadBuffer>> m_buffers;
+};
+
+}
+
+#endif
@@ -2,6 +2,7 @@
 #define K4MARLINWRAPPER_UTIL_H
 
 #include <iostream>
+#include <functional>
 #include <string>
 #include <regex>
 #include <vector>
@@ -9,7 +10,7 @@
 namespace k4MW::util {
 
 // Split a string by a regex
-std::vector<std::string> split(
+inline std::vector<std::string> split(
   const std::string& subject,
   const std::regex& re)
 {
@@ -21,13 +22,49 @@ std::vector<std::string> split(
 }
 
 // Split a string by any whitespace characters
-std::vector<std::string> split(
+inline std::vector<std::string> split(
   const std::string& subject)
 {
   std::regex re{"\\s+"};
   return split(subject, re);
 }
 
+// A job split over several processes tags the output files of each part. LcioEvent sets the tag
+// and the processor wrappers read it. The state lives in the k4MarlinWrapperUtil library, which
+// both component libraries link, and forked workers inherit it with the rest of the process.
+std::string outputTag();
+
+void setOutputTag(const std::string& tag);
+
+// Set when the tag is only known once the worker processes are forked after initialize
+bool outputTagDeferred();
+
+void setOutputTagDeferred();
+
+// Index of a forked worker process, 0 for the process that initialized the job
+int workerIndex();
+
+void setWorkerIndex(int worker);
+
+// Work the processor wrappers leave until all algorithms are initialized. The first algorithm to
+// start runs it, LcioEvent before it forks the worker processes. False if the work failed.
+void setStartHook(std::function<bool()> hook);
+
+bool runStartHook();
+
+// Insert the tag before the file extension: Output.slcio -> Output_tag.slcio
+inline std::string taggedFileName(const std::string& fileName, const std::string& tag) {
+  if (tag.empty()) {
+    return fileName;
+  }
+  const auto slash = fileName.rfind('/');
+  const auto dot   = fileName.rfind('.');
+  if (dot == std::string::npos or (slash != std::string::npos and dot < slash)) {
+    return fileName + "_" + tag;
+  }
+  return fileName.substr(0, dot) + "_" + tag + fileName.substr(dot);
+}
+
 }
 
 #endif
\ No newline at end of file
@@ -1,6 +1,7 @@
 #!/usr/bin/env python
 from __future__ import absolute_import, unicode_literals, print_function
 
+import argparse
 import sys
 from copy import deepcopy
 import os
@@ -143,31 +144,116 @@ def getGlobalParameters(tree):
   return getGlobalDict(tree.findall('global/parameter'))
 
 
-def resolveGroup(lines, proc, execGroup):
-  for member in execGroup:
-    if member.get('name') == proc:
-      for child in member:
-        if child.tag == "processor":
-          lines.append("algList.append(%s)" % child.get('name').replace(".", "_"))
+def appendProcessors(lines, executing):
+  """ append the executed processors in order, with the conditions of their <if> blocks """
+  for proc, condition in executing:
+    name = proc.replace(".", "_")
+    if condition:
+      lines.append("%s.Condition = \"%s\"" % (name, condition))
+    lines.append("algList.append(%s)" % name)
 
 
-def getExecutingProcessors(lines, tree):
-  """ compare the list of processors to execute, order matters """
-  execProc = tree.findall('execute/*')
+def combineConditions(outer, inner):
+  """ nested <if> blocks run their processors when both conditions are true """
+  if not outer:
+    return inner
+  return "(%s) && (%s)" % (outer, inner)
+
+
+def getExecutingProcessors(tree, execProc=None, condition=None):
+  """ return the (processor, condition) pairs of the execute section in order, resolving groups in <if> blocks """
+  if execProc is None:
+    execProc = tree.findall('execute/*')
   execGroup = tree.findall('group')
-  optProcessors = False
 
+  executing = []
   for proc in execProc:
     if proc.tag == "if":
-      for child in proc:
-        if child.tag == "processor":
-          optProcessors = True
-          lines.append("# algList.append(%s)  # %s" % (child.get('name').replace(".", "_"), proc.get('condition')))
+      executing += getExecutingProcessors(tree, list(proc), combineConditions(condition, proc.get('condition')))
     if proc.tag == "processor":
-      lines.append("algList.append(%s)" % proc.get('name'))
+      executing.append((proc.get('name'), condition))
     if proc.tag == "group":
-      resolveGroup(lines, proc.get('name'), execGroup)
-  return optProcessors
+      for member in execGroup:
+        if member.get('name') == proc.get('name'):
+          executing += [(child.get('name'), condition) for child in member if child.tag == "processor"]
+  return executing
+
+
+def getChainProcessors(tree):
+  """ return the processors of the execute section in order, including conditional ones and group members """
+  return [proc for proc, _ in getExecutingProcessors(tree)]
+
+
+def resolveRawConstants(value, tree):
+  """ replace ${constant} in value with the constant values of the steering file """
+  rawConstants = dict((const.attrib.get('name'), getValue(const, "")) for const in tree.findall('constants/constant'))
+  for _ in range(len(rawConstants) + 1):
+    resolved = re.sub(r'\$\{(\w*)\}', lambda match: rawConstants.get(match.group(1), match.group(0)), value)
+    if resolved == value:
+      break
+    value = resolved
+  return value
+
+
+def getCollectionFlow(tree):
+  """ return the input and output collections of each processor from the lcioInType and lcioOutType attributes """
+  flow = dict()
+  procElements = tree.findall('processor') + tree.findall('group/processor')
+  for proc in procElements:
+    inputs, outputs = [], []
+    groupParams = []
+    for group in tree.findall('group'):
+      if proc in group.findall('processor'):
+        groupParams = group.findall('parameter')
+    for param in groupParams + proc.findall('parameter'):
+      value = resolveRawConstants(getValue(param, ""), tree).split()
+      if param.get('lcioInType'):
+        inputs += value
+      if param.get('lcioOutType'):
+        outputs += value
+    flow[proc.get('name')] = (proc.get('type'), inputs, outputs)
+  return flow
+
+
+def getExternalInputs(tree):
+  """ collections read by the chain that are not produced by a processor executed before """
+  flow = getCollectionFlow(tree)
+  external, produced, untyped, writers = [], [], [], []
+  for proc in getChainProcessors(tree):
+    procType, inputs, outputs = flow.get(proc, (None, [], []))
+    if not inputs and not outputs:
+      untyped.append(proc)
+    if procType == "LCIOOutputProcessor":
+      writers.append(proc)
+    for col in inputs:
+      if col not in produced and col not in external:
+        external.append(col)
+    produced += [col for col in outputs if col not in produced]
+  return external, produced, untyped, writers
+
+
+def createInputPruning(lines, tree, dryRun, force):
+  """ restrict the collections read by LcioEvent to the external inputs of the chain """
+  external, produced, untyped, writers = getExternalInputs(tree)
+  print('Input collections read from file:')
+  for col in external:
+    print('  %s' % col)
+  print('Collections produced inside the chain:')
+  for col in produced:
+    print('  %s' % col)
+  print('All other collections in the input file are not read')
+  if untyped:
+    print('WARNING: no lcioInType/lcioOutType found for the parameters of: %s' % ", ".join(untyped))
+    print('         collections used by these processors are not known and may be dropped')
+  if writers:
+    print('WARNING: collections not read are also not written by: %s' % ", ".join(writers))
+  if dryRun:
+    print('Dry run: LcioEvent.Collections not set\n')
+    return
+  if untyped and not force:
+    print('LcioEvent.Collections not set because of the processors without typed collections, use --force-prune\n')
+    return
+  lines.append("read.Collections = [%s]\n" % ", ".join('"%s"' % col for col in external))
 
 
 def createHeader(lines):
@@ -217,6 +303,8 @@ def convertParamters(params, proc, globParams, constants):
   lines = []
   lines.append("%s.OutputLevel = %s " % (proc.replace(".", "_"), verbosityTranslator(globParams.get("Verbosity"))))
   lines.append("%s.ProcessorType = \"%s\" " % (proc.replace(".", "_"), params.get("type")))
+  if globParams.get("RandomSeed"):
+    lines.append("%s.RandomSeed = %s" % (proc.replace(".", "_"), globParams.get("RandomSeed")))
   lines.append("%s.Parameters = {" % proc.replace(".", "_"))
   for para in sorted(params):
     if para not in ["type", "Verbosity"]:
@@ -239,36 +327,40 @@ def convertProcessors(lines, tree, globParams, constants):
   return lines
 
 
-def generateGaudiSteering(tree):
+def generateGaudiSteering(tree, pruneInputs=False, dryRun=False, forcePrune=False):
   globParams = getGlobalParameters(tree)
   lines = []
   createHeader(lines)
   constants = convertConstants(lines, tree)
   createLcioReader(lines, globParams)
+  if pruneInputs or dryRun or forcePrune:
+    createInputPruning(lines, tree, dryRun, forcePrune)
   convertProcessors(lines, tree, globParams, constants)
-  optProcessors = getExecutingProcessors(lines, tree)
-  if optProcessors:
-    print('Optional Processors were found!')
-    print('Please uncomment the desired ones at the bottom of the resulting file\n')
+  appendProcessors(lines, getExecutingProcessors(tree))
   createFooter(lines, globParams)
   return lines
 
 
 def run():
-  args = sys.argv
-  if len(args) != 3:
-    print("incorrect number of input files, need one marlin steering files as argument")
-    print("convertMarlinSteeringToGaudi.py inputFile.xml outputFile.py")
-    exit(1)
+  parser = argparse.ArgumentParser(description="Convert a Marlin steering file to a Gaudi options file")
+  parser.add_argument("inputFile", help="Marlin steering file (.xml)")
+  parser.add_argument("outputFile", help="Gaudi options file to write (.py)")
+  parser.add_argument("--prune-inputs", action="store_true", dest="pruneInputs",
+                      help="only read the input collections not produced inside the processor chain")
+  parser.add_argument("--dry-run", action="store_true", dest="dryRun",
+                      help="report the collections --prune-inputs would read without applying it")
+  parser.add_argument("--force-prune", action="store_true", dest="forcePrune",
+                      help="prune the inputs even if some processors have no typed collection parameters")
+  args = parser.parse_args()
 
   try:
-    tree = getTree(args[1])
+    tree = getTree(args.inputFile)
   except Exception as ex:
     print("Exception when getting trees: %r " % ex)
     exit(1)
 
-  wf_file = open(args[2], 'w')
-  wf_file.write("\n".join(generateGaudiSteering(tree)))
+  wf_file = open(args.outputFile, 'w')
+  wf_file.write("\n".join(generateGaudiSteering(tree, args.pruneInputs, args.dryRun, args.forcePrune)))
 
 if __name__ == "__main__":
   run()
@@ -0,0 +1,66 @@
+#!/usr/bin/env python
+""" Merge the output files of a job split into shards or worker processes
+
+LCIO files (.slcio) are merged event by event with pyLCIO, keeping the run headers
+of the first file that contains each run. ROOT files, i.e. EDM4hep output and AIDA
+histograms, are merged with hadd.
+"""
+from __future__ import absolute_import, unicode_literals, print_function
+
+import argparse
+import subprocess
+import sys
+
+
+def mergeLcio(outputFile, inputFiles):
+  """ write the run headers and events of all input files to outputFile """
+  from pyLCIO import EVENT, IOIMPL
+
+  writer = IOIMPL.LCFactory.getInstance().createLCWriter()
+  writer.open(outputFile, EVENT.LCIO.WRITE_NEW)
+
+  runs = set()
+  events = 0
+  for inputFile in inputFiles:
+    reader = IOIMPL.LCFactory.getInstance().createLCReader()
+    reader.open(inputFile)
+    runHeader = reader.readNextRunHeader()
+    while runHeader:
+      if runHeader.getRunNumber() not in runs:
+        runs.add(runHeader.getRunNumber())
+        writer.writeRunHeader(runHeader)
+      runHeader = reader.readNextRunHeader()
+    reader.close()
+
+    reader.open(inputFile)
+    for event in reader:
+      writer.writeEvent(event)
+      events += 1
+    reader.close()
+
+  writer.close()
+  print("Merged %d events of %d runs into %s" % (events, len(runs), outputFile))
+
+
+def mergeRoot(outputFile, inputFiles):
+  """ merge EDM4hep and histogram files with ROOT's hadd """
+  subprocess.check_call(["hadd", "-f", outputFile] + inputFiles)
+
+
+def run():
+  parser = argparse.ArgumentParser(description="Merge the output files of a job split into shards or workers")
+  parser.add_argument("outputFile", help="merged file, the type is taken from the extension (.slcio or .root)")
+  parser.add_argument("inputFiles", nargs="+", help="files to merge, in the order of the events")
+  args = parser.parse_args()
+
+  if args.outputFile.endswith(".slcio"):
+    mergeLcio(args.outputFile, args.inputFiles)
+  elif args.outputFile.endswith(".root"):
+    mergeRoot(args.outputFile, args.inputFiles)
+  else:
+    print("Unknown output file type: %s" % args.outputFile)
+    sys.exit(1)
+
+
+if __name__ == "__main__":
+  run()
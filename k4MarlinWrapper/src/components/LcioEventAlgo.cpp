@@ -20,6 +20,25 @@
  */
 
 #include "k4MarlinWrapper/LcioEventAlgo.h"
+#include "k4MarlinWrapper/util/FileChunkCounter.h"
+#include "k4MarlinWrapper/util/SharedChunkCounter.h"
+#include "k4MarlinWrapper/util/TraceRecorder.h"
+#include "k4MarlinWrapper/util/k4MarlinWrapperUtil.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <GaudiKernel/AppReturnCode.h>
+#include <GaudiKernel/IEventProcessor.h>
+#include <GaudiKernel/IProperty.h>
+#include <GaudiKernel/ThreadLocalContext.h>
+
+#include <IMPL/LCRunHeaderImpl.h>
 
 
 DECLARE_COMPONENT(LcioEvent)
@@ -27,22 +46,391 @@ DECLARE_COMPONENT(LcioEvent)
 LcioEvent::LcioEvent(const std::string& name, ISvcLocator* pSL) : GaudiAlgorithm(name, pSL) {}
 
 StatusCode LcioEvent::initialize() {
-  m_reader = IOIMPL::LCFactory::getInstance()->createLCReader();
-  m_reader->open(m_fileNames);
+  if (not m_traceFile.value().empty()) {
+    k4MW::util::TraceRecorder::instance().enable(m_traceFile);
+  }
+  if (not m_metricsFile.value().empty()) {
+    auto& exporter = k4MW::util::MetricsExporter::instance();
+    exporter.enable(m_metricsFile, m_metricsInterval);
+    m_eventsMetric = &exporter.counter("k4marlinwrapper_events_read_total", "Events passed to the event loop", "reader");
+    m_readMetric   = &exporter.histogram("k4marlinwrapper_reader_seconds", "Time per event of the reader", "reader",
+                                         "stage=\"read\"");
+    m_waitMetric   = &exporter.histogram("k4marlinwrapper_reader_seconds", "Time per event of the reader", "reader",
+                                         "stage=\"wait\"");
+    exporter.addRate(*m_eventsMetric, "k4marlinwrapper_events_per_second", "Events per second passed to the event loop",
+                     "reader");
+  }
+  if (readEventSelection().isFailure()) {
+    return StatusCode::FAILURE;
+  }
+  if (m_shardCount > 1) {
+    if (m_shardIndex >= m_shardCount) {
+      error() << "ShardIndex " << m_shardIndex << " out of range for ShardCount " << m_shardCount << endmsg;
+      return StatusCode::FAILURE;
+    }
+    k4MW::util::setOutputTag("shard" + std::to_string(m_shardIndex.value()));
+  }
+  if (not m_workQueue.empty()) {
+    if (m_shardCount > 1) {
+      error() << "WorkQueue and ShardCount cannot be used together" << endmsg;
+      return StatusCode::FAILURE;
+    }
+    // each job gets a number from the queue to name its output
+    const auto job = k4MW::util::FileChunkCounter(m_workQueue, "jobs").claim();
+    k4MW::util::setOutputTag("job" + std::to_string(job));
+    m_chunkCounter = std::make_unique<k4MW::util::FileChunkCounter>(m_workQueue, "chunks");
+    info() << "Taking events from the work queue in " << m_workQueue.value() << " as job " << job << endmsg;
+  }
+  if (m_numberOfProcesses > 1) {
+    // the worker index is only known after the fork, output processors wait for it
+    k4MW::util::setOutputTagDeferred();
+  }
   info() << "Initialized the LcioEvent Algo: " << m_fileNames[0] << endmsg;
   return StatusCode::SUCCESS;
 }
 
+StatusCode LcioEvent::start() {
+  // the processors with ParallelInit are initialized here, so that forked workers share them
+  if (not k4MW::util::runStartHook()) {
+    error() << "Failed to initialize the processors" << endmsg;
+    return StatusCode::FAILURE;
+  }
+  if (selectEventRange().isFailure()) {
+    return StatusCode::FAILURE;
+  }
+  if (m_numberOfProcesses > 1 and forkWorkers().isFailure()) {
+    return StatusCode::FAILURE;
+  }
+
+  // opened after the fork, every process needs its own file handles
+  const bool directAccess = m_skipEvents > 0 or not m_selectedEvents.empty() or m_firstIndex > 0 or m_chunkCounter;
+  // direct access uses the event index of the file, or builds it when the file has none
+  m_reader = std::make_unique<MT::LCReader>(directAccess ? MT::LCReader::directAccess : 0);
+  m_reader->open(m_fileNames);
+
+  if (not m_selectedEvents.empty()) {
+    info() << "Processing " << m_selectedEvents.size() << " selected events" << endmsg;
+    if (m_skipEvents > 0) {
+      warning() << "SkipEvents is ignored when events are selected by run and event number" << endmsg;
+    }
+  } else if (m_skipEvents > 0) {
+    info() << "Skipping the first " << m_skipEvents << " events" << endmsg;
+  }
+
+  const auto readCollections = collectionsToRead();
+  if (not readCollections.empty()) {
+    info() << "Decoding " << readCollections.size() << " collections from the input:";
+    for (const auto& collection : readCollections) {
+      info() << " " << collection;
+    }
+    info() << endmsg;
+    m_reader->setReadCollectionNames(readCollections);
+  }
+
+  if (m_eventsInFlight > 0) {
+    info() << "Reading up to " << m_eventsInFlight << " events ahead on a separate thread" << endmsg;
+    m_eventQueue   = std::make_unique<EventQueue>(m_eventsInFlight);
+    m_readerThread = std::thread(&LcioEvent::readEvents, this);
+  } else {
+    m_nextEvent = readQueuedEvent();
+  }
+  return GaudiAlgorithm::start();
+}
+
+StatusCode LcioEvent::selectEventRange() {
+  const bool limited = m_numberOfEvents >= 0 or m_shardCount > 1 or m_numberOfProcesses > 1 or m_chunkCounter;
+  if (not limited) {
+    return StatusCode::SUCCESS;
+  }
+
+  std::size_t available = m_selectedEvents.size();
+  if (m_selectedEvents.empty()) {
+    // the number of events is taken from the event index, without reading the events
+    MT::LCReader countReader(MT::LCReader::directAccess);
+    countReader.open(m_fileNames);
+    const std::size_t inputEvents = countReader.getNumberOfEvents();
+    countReader.close();
+    available = inputEvents > m_skipEvents ? inputEvents - m_skipEvents : 0;
+  }
+
+  m_firstIndex = available * m_shardIndex / m_shardCount;
+  m_endIndex   = available * (m_shardIndex + 1) / m_shardCount;
+  if (m_numberOfEvents >= 0) {
+    m_endIndex = std::min<std::size_t>(m_endIndex, m_firstIndex + m_numberOfEvents);
+  }
+  if (m_numberOfProcesses > 1 or m_chunkCounter) {
+    // EvtMax limits the events of the whole job, or of all jobs on the work queue, not of each worker
+    SmartIF<IProperty> appMgr(serviceLocator());
+    const int          evtMax = appMgr ? std::stoi(appMgr->getProperty("EvtMax").toString()) : -1;
+    if (evtMax >= 0) {
+      m_endIndex = std::min<std::size_t>(m_endIndex, m_firstIndex + evtMax);
+    }
+  }
+  m_nextIndex = m_firstIndex;
+
+  info() << "Reading events " << m_firstIndex << " to " << std::min(m_endIndex, available) << " of " << available;
+  if (m_shardCount > 1) {
+    info() << " for shard " << m_shardIndex << " of " << m_shardCount;
+  }
+  info() << endmsg;
+  return StatusCode::SUCCESS;
+}
+
+StatusCode LcioEvent::forkWorkers() {
+  if (not m_chunkCounter) {
+    m_chunkCounter = std::make_unique<k4MW::util::SharedChunkCounter>();
+  }
+  info() << "Forking " << m_numberOfProcesses - 1 << " worker processes, claiming " << m_chunkSize
+         << " events at a time" << endmsg;
+
+  // the initial process always gets the first chunk
+  claimChunk();
+  const auto jobTag    = k4MW::util::outputTag();
+  const auto workerTag = [&jobTag](unsigned int worker) {
+    return (jobTag.empty() ? "" : jobTag + "_") + "worker" + std::to_string(worker);
+  };
+  k4MW::util::setOutputTag(workerTag(0));
+
+  // output still buffered at the fork would be written again by every worker
+  std::cout.flush();
+  std::fflush(nullptr);
+  for (unsigned int worker = 1; worker < m_numberOfProcesses; ++worker) {
+    const pid_t pid = fork();
+    if (pid < 0) {
+      error() << "Failed to fork worker " << worker << endmsg;
+      return StatusCode::FAILURE;
+    }
+    if (pid == 0) {
+      m_workers.clear();
+      // the first chunk belongs to the initial process
+      m_claimedChunks.clear();
+      k4MW::util::setWorkerIndex(worker);
+      k4MW::util::setOutputTag(workerTag(worker));
+      claimChunk();
+      if (m_nextIndex >= m_endIndex) {
+        // nothing was initialized for this worker's output yet, leave without finalizing
+        info() << "Worker " << worker << " has no events to process" << endmsg;
+        std::cout.flush();
+        _exit(0);
+      }
+      info() << "Worker " << worker << " started with pid " << getpid() << endmsg;
+      return StatusCode::SUCCESS;
+    }
+    m_workers.push_back(pid);
+  }
+  return StatusCode::SUCCESS;
+}
+
+void LcioEvent::claimChunk() {
+  m_claimedChunks.push_back(m_chunkCounter->claim());
+  m_nextIndex = m_firstIndex + m_claimedChunks.back() * m_chunkSize;
+  m_chunkEnd  = m_nextIndex + m_chunkSize;
+}
+
+void LcioEvent::completeChunk(std::size_t chunk) {
+  if (not m_completedChunks.insert(chunk).second) {
+    return;
+  }
+  try {
+    m_chunkCounter->complete(chunk);
+  } catch (const std::exception& exception) {
+    warning() << "Failed to mark chunk " << chunk << " as completed: " << exception.what() << endmsg;
+  }
+}
+
+bool LcioEvent::claimNextIndex(std::size_t& index) {
+  if (m_chunkCounter and m_nextIndex >= m_chunkEnd) {
+    claimChunk();
+  }
+  if (m_nextIndex >= m_endIndex) {
+    m_inputDone = true;
+    return false;
+  }
+  index = m_nextIndex++;
+  return true;
+}
+
+std::vector<std::string> LcioEvent::collectionsToRead() {
+  std::vector<std::string> collections = m_collections;
+  if (m_dropCollections.empty()) {
+    return collections;
+  }
+
+  if (collections.empty()) {
+    // LCIO only supports selecting the collections to read, take the available ones from the first event
+    MT::LCReader firstReader(0);
+    firstReader.open(m_fileNames);
+    const auto firstEvent = firstReader.readNextEvent();
+    firstReader.close();
+    if (firstEvent == nullptr) {
+      return collections;
+    }
+    collections = *firstEvent->getCollectionNames();
+    warning() << "DropCollections: reading the collections present in the first event, "
+              << "collections only present in later events are not read" << endmsg;
+  }
+
+  for (const auto& drop : m_dropCollections) {
+    auto it = std::find(collections.begin(), collections.end(), drop);
+    if (it == collections.end()) {
+      warning() << "DropCollections: collection " << drop << " not found in the input" << endmsg;
+    } else {
+      collections.erase(it);
+    }
+  }
+  if (collections.empty()) {
+    warning() << "DropCollections: all collections dropped, LCIO will read every collection" << endmsg;
+  }
+  return collections;
+}
+
+StatusCode LcioEvent::readEventSelection() {
+  m_selectedEvents = m_eventList;
+  if (m_eventListFile.empty()) {
+    return StatusCode::SUCCESS;
+  }
+
+  std::ifstream listFile(m_eventListFile);
+  if (not listFile) {
+    error() << "Cannot open EventListFile " << m_eventListFile.value() << endmsg;
+    return StatusCode::FAILURE;
+  }
+  std::string line;
+  while (std::getline(listFile, line)) {
+    if (line.empty() or line[0] == '#') {
+      continue;
+    }
+    std::istringstream fields(line);
+    int                run = 0, event = 0;
+    if (not(fields >> run >> event)) {
+      error() << "EventListFile: expected 'run event' but found '" << line << "'" << endmsg;
+      return StatusCode::FAILURE;
+    }
+    m_selectedEvents.emplace_back(run, event);
+  }
+  return StatusCode::SUCCESS;
+}
+
+std::unique_ptr<EVENT::LCEvent> LcioEvent::readNextEvent() {
+  std::size_t index = 0;
+  while (claimNextIndex(index)) {
+    if (m_selectedEvents.empty()) {
+      const std::size_t position = m_skipEvents + index;
+      if (position > m_readerPosition) {
+        m_reader->skipNEvents(position - m_readerPosition);
+      }
+      m_readerPosition = position + 1;
+      return m_reader->readNextEvent(EVENT::LCIO::UPDATE);
+    }
+    if (index >= m_selectedEvents.size()) {
+      return nullptr;
+    }
+    const auto [run, event] = m_selectedEvents[index];
+    auto theEvent           = m_reader->readEvent(run, event, EVENT::LCIO::UPDATE);
+    if (theEvent != nullptr) {
+      return theEvent;
+    }
+    // reported at finalize, this may run on the reader thread
+    m_missingEvents.emplace_back(run, event);
+  }
+  return nullptr;
+}
+
+LcioEvent::QueuedEvent LcioEvent::readQueuedEvent() {
+  k4MW::util::TraceRecorder::Scope trace("ReadEvent", "read");
+  const auto                       start = std::chrono::steady_clock::now();
+  QueuedEvent                      queued;
+  queued.event = readNextEvent();
+  if (not m_claimedChunks.empty()) {
+    queued.chunk = m_claimedChunks.back();
+  }
+  if (queued.event != nullptr) {
+    trace.setEvent(queued.event->getRunNumber(), queued.event->getEventNumber());
+  }
+  if (m_readMetric != nullptr) {
+    const auto read = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start);
+    m_readMetric->observe(read.count());
+  }
+  return queued;
+}
+
+void LcioEvent::readEvents() {
+  try {
+    // stay one event ahead to know which event is the last one
+    auto current = readQueuedEvent();
+    while (current.event != nullptr) {
+      auto next    = readQueuedEvent();
+      current.last = next.event == nullptr;
+      if (not m_eventQueue->push(std::move(current))) {
+        break;
+      }
+      current = std::move(next);
+    }
+  } catch (const std::exception& ex) {
+    m_readerError = ex.what();
+  }
+  m_eventQueue->close();
+}
+
 StatusCode LcioEvent::execute() {
-  auto theEvent = m_reader->readNextEvent(EVENT::LCIO::UPDATE);
-  if (theEvent == nullptr) {
+  const auto  start = std::chrono::steady_clock::now();
+  QueuedEvent theEvent;
+  {
+    k4MW::util::TraceRecorder::Scope trace("WaitForEvent", "read", Gaudi::Hive::currentContext().slot());
+    if (m_eventQueue) {
+      if (not m_eventQueue->pop(theEvent) and not m_readerError.empty()) {
+        error() << "Failed reading from file: " << m_readerError << endmsg;
+      }
+    } else {
+      theEvent      = std::move(m_nextEvent);
+      m_nextEvent   = readQueuedEvent();
+      theEvent.last = m_nextEvent.event == nullptr;
+    }
+    if (theEvent.event != nullptr) {
+      trace.setEvent(theEvent.event->getRunNumber(), theEvent.event->getEventNumber());
+    }
+  }
+  const auto waited = std::chrono::steady_clock::now() - start;
+  m_readWait += waited;
+  if (m_eventsMetric != nullptr) {
+    k4MW::util::MetricsExporter::instance().ensureRunning();
+    m_waitMetric->observe(std::chrono::duration_cast<std::chrono::nanoseconds>(waited).count());
+    if (theEvent.event != nullptr) {
+      m_eventsMetric->add();
+    }
+  }
+  if (theEvent.event == nullptr) {
+    error() << "No event left in the input" << endmsg;
+    return StatusCode::FAILURE;
+  }
+  ++m_eventsRead;
+
+  if (m_chunkCounter and theEvent.chunk != m_processingChunk) {
+    // the previous event, and with it the previous chunk of this process, went through the whole sequence
+    if (m_processingChunk) {
+      completeChunk(*m_processingChunk);
+    }
+    m_processingChunk = theEvent.chunk;
+  }
+
+  if (theEvent.last) {
+    // finish the current event, then end the event loop cleanly
+    m_lastEventStarted = true;
+    debug() << "Last event of the input, stopping the event loop" << endmsg;
+    SmartIF<IEventProcessor> eventProcessor(serviceLocator());
+    if (eventProcessor) {
+      eventProcessor->stopRun().ignore();
+    }
+  }
+
+  if (m_runHeaders and registerRunHeader(theEvent.event->getRunNumber()).isFailure()) {
     return StatusCode::FAILURE;
   }
 
   // pass theEvent to the DataStore, so we can access them in our processor wrappers
-  info() << "Reading from file: " << m_fileNames[0] << endmsg;
+  debug() << "Reading from file: " << m_fileNames[0] << endmsg;
 
-  auto pO = std::make_unique<LCEventWrapper>(theEvent);
+  auto pO = std::make_unique<LCEventWrapper>(theEvent.event.release(), true);
   const StatusCode sc = eventSvc()->registerObject("/Event/LCEvent", pO.release());
   if (sc.isFailure()) {
     error() << "Failed to store the LCEvent" << endmsg;
@@ -50,3 +438,114 @@ StatusCode LcioEvent::execute() {
   }
   return StatusCode::SUCCESS;
 }
+
+StatusCode LcioEvent::registerRunHeader(int run) {
+  if (m_runCache == nullptr or m_runCache->run() != run) {
+    debug() << "New run " << run << endmsg;
+    m_runHeader = readRunHeader(run);
+    m_runCache  = std::make_shared<k4MW::util::RunCache>(run);
+  }
+  auto             pO = std::make_unique<LCRunHeaderWrapper>(m_runHeader, m_runCache);
+  const StatusCode sc = eventSvc()->registerObject(LCRunHeaderWrapper::Location, pO.release());
+  if (sc.isFailure()) {
+    error() << "Failed to store the LCRunHeader" << endmsg;
+  }
+  return sc;
+}
+
+std::shared_ptr<EVENT::LCRunHeader> LcioEvent::readRunHeader(int run) {
+  try {
+    if (m_runHeaderReader == nullptr) {
+      // the event reader may read sequentially, and on another thread
+      m_runHeaderReader = std::make_unique<MT::LCReader>(MT::LCReader::directAccess);
+      m_runHeaderReader->open(m_fileNames);
+    }
+    std::shared_ptr<EVENT::LCRunHeader> header = m_runHeaderReader->readRunHeader(run, EVENT::LCIO::READ_ONLY);
+    if (header != nullptr) {
+      return header;
+    }
+  } catch (const std::exception& exception) {
+    debug() << "Failed reading the run header of run " << run << ": " << exception.what() << endmsg;
+  }
+  warning() << "No run header for run " << run << " in the input, the processors get one with the run number only"
+            << endmsg;
+  auto header = std::make_shared<IMPL::LCRunHeaderImpl>();
+  header->setRunNumber(run);
+  return header;
+}
+
+StatusCode LcioEvent::finalize() {
+  if (m_eventQueue) {
+    // unblock the reading stage if it is still waiting for a free slot
+    m_eventQueue->close();
+  }
+  if (m_readerThread.joinable()) {
+    m_readerThread.join();
+  }
+  if (m_reader) {
+    m_reader->close();
+  }
+  if (m_runHeaderReader) {
+    m_runHeaderReader->close();
+  }
+
+  // the chunk of the last event is complete if the event loop ended with that event and without errors
+  if (m_chunkCounter and m_lastEventStarted and m_processingChunk) {
+    SmartIF<IProperty> appMgr(serviceLocator());
+    if (appMgr and Gaudi::getAppReturnCode(appMgr) == Gaudi::ReturnCode::Success) {
+      completeChunk(*m_processingChunk);
+    }
+  }
+
+  for (const auto& [run, event] : m_missingEvents) {
+    warning() << "Selected event " << event << " of run " << run << " not found in the input" << endmsg;
+  }
+
+  const std::chrono::duration<double> readWait = m_readWait;
+  info() << "Event loop waited " << readWait.count() << " s for " << m_eventsRead << " events from the reader" << endmsg;
+
+  auto& traceRecorder = k4MW::util::TraceRecorder::instance();
+  if (traceRecorder.enabled() and not traceRecorder.write()) {
+    warning() << "Failed to write the trace to " << k4MW::util::TraceRecorder::instance().file() << endmsg;
+  }
+  if (m_eventsMetric != nullptr) {
+    k4MW::util::MetricsExporter::instance().stop();
+  }
+
+  StatusCode sc = StatusCode::SUCCESS;
+  for (const auto pid : m_workers) {
+    int status = 0;
+    waitpid(pid, &status, 0);
+    if (not WIFEXITED(status) or WEXITSTATUS(status) != 0) {
+      error() << "Worker process " << pid << " failed" << endmsg;
+      sc = StatusCode::FAILURE;
+    }
+  }
+  if (not m_workers.empty()) {
+    info() << "All " << m_workers.size() << " worker processes finished" << endmsg;
+  }
+
+  if (m_chunkCounter and m_inputDone and k4MW::util::workerIndex() == 0) {
+    const auto chunkCount = (m_endIndex - m_firstIndex + m_chunkSize - 1) / m_chunkSize;
+    const auto incomplete = m_chunkCounter->incomplete(chunkCount);
+    if (not incomplete.empty()) {
+      auto& message = warning();
+      message << incomplete.size() << " chunks of " << m_chunkSize
+              << " events were claimed by jobs that are still running or failed, starting at";
+      for (const auto chunk : incomplete) {
+        const auto index = m_firstIndex + chunk * m_chunkSize;
+        if (m_selectedEvents.empty()) {
+          message << " event " << m_skipEvents + index << " of the input,";
+        } else {
+          message << " run " << m_selectedEvents[index].first << " event " << m_selectedEvents[index].second << ",";
+        }
+      }
+      message << " rerun their events if these jobs failed" << endmsg;
+    }
+  }
+
+  if (sc.isFailure()) {
+    return sc;
+  }
+  return GaudiAlgorithm::finalize();
+}
@@ -23,8 +23,137 @@
 
 #include "k4MarlinWrapper/MarlinProcessorWrapper.h"
 
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <fstream>
+#include <mutex>
+#include <set>
+#include <sstream>
+#include <thread>
+
+#include <GaudiKernel/ConcurrencyFlags.h>
+#include <GaudiKernel/IEventProcessor.h>
+#include <GaudiKernel/ThreadLocalContext.h>
+
+#include <marlin/Exceptions.h>
+
 DECLARE_COMPONENT(MarlinProcessorWrapper)
 
+namespace {
+  // Parameters naming the file written by processors that produce one output file per job
+  const std::map<std::string, std::string> OUTPUT_FILE_PARAMETERS = {
+    {"LCIOOutputProcessor", "LCIOOutputFile"},
+    {"AIDAProcessor", "FileName"},
+  };
+
+  // Marlin processors take their per-event seeds from Global::EVENTSEEDER, which derives them from the
+  // RandomSeed global parameter, the run and the event number. Pointing the globals at the wrapper's own
+  // seeder and seed makes the seeds of a processor independent of the other processors and of the order
+  // in which events are processed. The globals belong to the process, so this only holds while one
+  // processor call runs at a time: serial event loops and forked worker processes, not multiple threads.
+  template <typename T>
+  class GlobalScope {
+  public:
+    GlobalScope(T*& global, T* value) : m_global(global), m_previous(global) { m_global = value; }
+    ~GlobalScope() { m_global = m_previous; }
+
+    GlobalScope(const GlobalScope&) = delete;
+    GlobalScope& operator=(const GlobalScope&) = delete;
+
+  private:
+    T*& m_global;
+    T*  m_previous;
+  };
+
+  using k4MW::util::ProcessorProfile;
+  using StartupTimer = k4MW::util::StartupProfile::Timer;
+
+  // Profiles, traces and exports the time of one stage of the conversions and processor call of an event
+  class StageScope {
+  public:
+    StageScope(ProcessorProfile* profile, ProcessorProfile::Stage stage,
+               const std::array<const char*, ProcessorProfile::NStages>& traceNames,
+               const std::array<k4MW::util::MetricHistogram*, ProcessorProfile::NStages>& metrics,
+               const EVENT::LCEvent* event)
+        : m_timer(profile, stage),
+          m_trace(traceNames[stage], stage == ProcessorProfile::Process ? "process" : "convert",
+                  Gaudi::Hive::currentContext().slot()),
+          m_metric(metrics[stage]) {
+      m_trace.setEvent(event->getRunNumber(), event->getEventNumber());
+      if (m_metric != nullptr) {
+        m_start = std::chrono::steady_clock::now();
+      }
+    }
+    ~StageScope() {
+      if (m_metric != nullptr) {
+        m_metric->observe(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - m_start).count());
+      }
+    }
+
+    StageScope(const StageScope&) = delete;
+    StageScope& operator=(const StageScope&) = delete;
+
+    void setInputSize(std::uint64_t size) { m_timer.setInputSize(size); }
+
+  private:
+    ProcessorProfile::Timer               m_timer;
+    k4MW::util::TraceRecorder::Scope      m_trace;
+    k4MW::util::MetricHistogram*          m_metric;
+    std::chrono::steady_clock::time_point m_start;
+  };
+
+  // Libraries listed in MARLIN_DLL, in order
+  std::vector<std::string> marlinLibraries() {
+    const char* const marlin_dll = getenv("MARLIN_DLL");
+    if (marlin_dll == nullptr) {
+      return {};
+    }
+    std::vector<std::string> libraries = k4MW::util::split(marlin_dll, std::regex{":+"});
+    libraries.erase(std::remove(libraries.begin(), libraries.end(), ""), libraries.end());
+    return libraries;
+  }
+
+  // getProcessor of a type that is not registered leaves an empty entry in the ProcessorMgr
+  std::set<std::string> registeredProcessorTypes() {
+    auto*                 manager = marlin::ProcessorMgr::instance();
+    std::set<std::string> types;
+    for (const auto& type : manager->getAvailableProcessorTypes()) {
+      if (manager->getProcessor(type) != nullptr) {
+        types.insert(type);
+      }
+    }
+    return types;
+  }
+
+  // Libraries of MARLIN_DLL loaded by all wrappers, with their load time
+  struct LoadedLibraries {
+    std::map<std::string, double>           seconds;
+    bool                                    all       = false;
+    bool                                    indexRead = false;
+    std::optional<k4MW::util::LibraryIndex> index;
+  };
+
+  LoadedLibraries& loadedLibraries() {
+    static LoadedLibraries loaded;
+    return loaded;
+  }
+
+  // 32 bit FNV-1a hash of the global seed and the processor name
+  unsigned int processorSeed(unsigned int globalSeed, const std::string& processorName) {
+    unsigned int hash = 2166136261u;
+    auto         add  = [&hash](unsigned char byte) { hash = (hash ^ byte) * 16777619u; };
+    for (int shift = 0; shift < 32; shift += 8) {
+      add((globalSeed >> shift) & 0xff);
+    }
+    for (const char c : processorName) {
+      add(c);
+    }
+    return hash;
+  }
+}
+
 MarlinProcessorWrapper::MarlinProcessorWrapper(const std::string& name, ISvcLocator* pSL) : GaudiAlgorithm(name, pSL) {
   // register log level names with the logstream ---------
   streamlog::out.addLevelName<streamlog::DEBUG>();
@@ -80,31 +209,110 @@ MarlinProcessorWrapper::MarlinProcessorWrapper(const std::string& name, ISvcLoca
 StatusCode MarlinProcessorWrapper::loadProcessorLibraries() const {
   // Load all libraries from the marlin_dll
   info() << "looking for marlindll" << endmsg;
-  const char* const marlin_dll = getenv("MARLIN_DLL");
-  if (marlin_dll == nullptr) {
+  const auto libraries = marlinLibraries();
+  if (libraries.empty()) {
     warning() << "MARLIN_DLL not set, not loading any processors " << endmsg;
-  } else {
-    info() << "Found marlin_dll " << marlin_dll << endmsg;
-    const std::string marlin_dll_str(marlin_dll);
-    std::regex re{":+"};
-    std::vector<std::string> libraries = k4MW::util::split(marlin_dll_str, re);
-    if (libraries.back().empty())
-      libraries.pop_back();
-    for (const auto& library : libraries) {
-      info() << "Loading library " << library << endmsg;
-      auto ret = gSystem->Load(library.c_str());
-      if (ret < 0) {
-        error() << "Failed to load " << library << "   " << gSystem->GetErrorStr() << endmsg;
-        return StatusCode::FAILURE;
+    return StatusCode::SUCCESS;
+  }
+  auto& loaded = loadedLibraries();
+  auto  index  = loaded.index.value_or(k4MW::util::LibraryIndex());
+  index.libraries.clear();
+  for (const auto& library : libraries) {
+    const auto before = registeredProcessorTypes();
+    if (loadProcessorLibrary(library).isFailure()) {
+      return StatusCode::FAILURE;
+    }
+    // types of a library loaded before, e.g. through the index, are kept from the previous index
+    for (const auto& type : registeredProcessorTypes()) {
+      if (before.count(type) == 0) {
+        index.types[type] = library;
       }
     }
+    auto stamp    = k4MW::util::LibraryIndex::stamp(library);
+    stamp.seconds = loaded.seconds.at(library);
+    index.libraries.push_back(stamp);
+  }
+  loaded.all = true;
+
+  if (not m_libraryIndex.value().empty()) {
+    if (index.write(m_libraryIndex)) {
+      info() << "Wrote the processor library index " << m_libraryIndex.value() << endmsg;
+    } else {
+      warning() << "Failed to write the processor library index " << m_libraryIndex.value() << endmsg;
+    }
+    loaded.index = std::move(index);
   }
   return StatusCode::SUCCESS;
 }
 
+StatusCode MarlinProcessorWrapper::loadProcessorLibrary(const std::string& library) const {
+  auto& loaded = loadedLibraries();
+  if (loaded.seconds.count(library) != 0) {
+    return StatusCode::SUCCESS;
+  }
+  info() << "Loading library " << library << endmsg;
+  const auto start = std::chrono::steady_clock::now();
+  auto       ret   = gSystem->Load(library.c_str());
+  if (ret < 0) {
+    error() << "Failed to load " << library << "   " << gSystem->GetErrorStr() << endmsg;
+    return StatusCode::FAILURE;
+  }
+  loaded.seconds[library] = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  return StatusCode::SUCCESS;
+}
+
+StatusCode MarlinProcessorWrapper::loadLibraryFor(const std::string& processorType) const {
+  if (registeredProcessorTypes().count(processorType) != 0) {
+    return StatusCode::SUCCESS;
+  }
+  auto& loaded = loadedLibraries();
+  if (loaded.all) {
+    // instantiateProcessor reports the unknown type
+    return StatusCode::SUCCESS;
+  }
+  if (not loaded.indexRead) {
+    loaded.indexRead = true;
+    loaded.index     = k4MW::util::LibraryIndex::read(m_libraryIndex);
+    if (loaded.index and not loaded.index->matches(marlinLibraries())) {
+      info() << "MARLIN_DLL changed since the processor library index was built, rebuilding it" << endmsg;
+      loaded.index.reset();
+    }
+  }
+  if (loaded.index) {
+    const auto library = loaded.index->types.find(processorType);
+    if (library != loaded.index->types.end()) {
+      // a library that needs another one of MARLIN_DLL without linking it fails, loading all of them in order works
+      if (loadProcessorLibrary(library->second).isSuccess() and registeredProcessorTypes().count(processorType) != 0) {
+        return StatusCode::SUCCESS;
+      }
+    }
+    warning() << processorType << " is not in the processor library index, loading all of MARLIN_DLL" << endmsg;
+  }
+  return loadProcessorLibraries();
+}
+
+void MarlinProcessorWrapper::reportLibraryLoading() const {
+  const auto& loaded = loadedLibraries();
+  if (not loaded.index or loaded.all) {
+    return;
+  }
+  double loadedSeconds = 0;
+  for (const auto& [library, seconds] : loaded.seconds) {
+    loadedSeconds += seconds;
+  }
+  double savedSeconds = 0;
+  for (const auto& library : loaded.index->libraries) {
+    if (loaded.seconds.count(library.path) == 0) {
+      savedSeconds += library.seconds;
+    }
+  }
+  info() << "Loaded " << loaded.seconds.size() << " of " << loaded.index->libraries.size()
+         << " libraries of MARLIN_DLL in " << loadedSeconds << " s, not loading the others saved about " << savedSeconds
+         << " s" << endmsg;
+}
 
 std::shared_ptr<marlin::StringParameters> MarlinProcessorWrapper::parseParameters(
-  const Gaudi::Property<std::map<std::string, std::vector<std::string>>>& parameters,
+  const std::map<std::string, std::vector<std::string>>& parameters,
   std::string& verbosity) const
 {
   auto parameters_ptr = std::make_shared<marlin::StringParameters>();
@@ -131,6 +339,22 @@ std::shared_ptr<marlin::StringParameters> MarlinProcessorWrapper::parseParameter
 }
 
 
+std::map<std::string, std::vector<std::string>> MarlinProcessorWrapper::taggedParameters() const {
+  std::map<std::string, std::vector<std::string>> parameters = m_parameters;
+  const auto tag = k4MW::util::outputTag();
+  const auto outputFile = OUTPUT_FILE_PARAMETERS.find(m_processorType);
+  if (tag.empty() or outputFile == OUTPUT_FILE_PARAMETERS.end()) {
+    return parameters;
+  }
+  auto fileParameter = parameters.find(outputFile->second);
+  if (fileParameter != parameters.end() and fileParameter->second.size() == 1) {
+    fileParameter->second[0] = k4MW::util::taggedFileName(fileParameter->second[0], tag);
+    info() << "Writing output of " << name() << " to " << fileParameter->second[0] << endmsg;
+  }
+  return parameters;
+}
+
+
 StatusCode MarlinProcessorWrapper::instantiateProcessor(
   std::shared_ptr<marlin::StringParameters>& parameters,
   Gaudi::Property<std::string>& processorTypeStr)
@@ -152,114 +376,719 @@ StatusCode MarlinProcessorWrapper::instantiateProcessor(
   return StatusCode::SUCCESS;
 }
 
+template <typename T>
+bool MarlinProcessorWrapper::checkJobOption(const Gaudi::Property<T>& property, const T& unset, bool firstDecides) const {
+  auto&      options = JobOptions();
+  const auto value   = property.toString();
+  const auto option  = options.find(property.name());
+  if (option == options.end()) {
+    if (firstDecides or property.value() != unset) {
+      options.emplace(property.name(), std::make_pair(value, name()));
+    }
+    return true;
+  }
+  if (property.value() == unset or option->second.first == value) {
+    return true;
+  }
+  error() << property.name() << " is an option of the whole job, " << value << " conflicts with "
+          << option->second.first << " of " << option->second.second << ": set it on "
+          << (firstDecides ? "the first wrapper" : "one wrapper, or to the same value") << endmsg;
+  return false;
+}
+
 StatusCode MarlinProcessorWrapper::initialize() {
+  // options of the whole job, used by the first wrapper or by whichever sets them; & reports every conflict
+  const bool consistent = checkJobOption(m_libraryIndex, std::string(), true) &
+                          checkJobOption(m_asyncLogging, false, true) & checkJobOption(m_logRateLimit, 0u, true) &
+                          checkJobOption(m_logRateWindow, 10u, true) & checkJobOption(m_parallelInit, 0u, true) &
+                          checkJobOption(m_profileFile, std::string(), false) &
+                          checkJobOption(m_startupFile, std::string(), false) &
+                          checkJobOption(m_metricsFile, std::string(), false) &
+                          checkJobOption(m_metricsInterval, 10u, false) &
+                          checkJobOption(m_traceFile, std::string(), false) &
+                          checkJobOption(m_eventTimeBudget, 0., false);
+  if (not consistent) {
+    return StatusCode::FAILURE;
+  }
+
   // initalize global marlin information, maybe betters as a _tool_
   static bool once = true;
   if (once) {
     once = false;
-    streamlog::out.init(std::cout, "k4MarlinWrapper");
+    if (m_asyncLogging or m_logRateLimit > 0) {
+      auto& sink = k4MW::util::AsyncLogSink::instance();
+      sink.start(std::cout, m_logRateLimit, std::chrono::seconds(std::max(m_logRateWindow.value(), 1u)));
+      streamlog::out.init(sink.stream(), "k4MarlinWrapper");
+    } else {
+      streamlog::out.init(std::cout, "k4MarlinWrapper");
+    }
+    // reading the options, the application manager and the services, up to the first processor
+    const auto beforeProcessors = k4MW::util::StartupProfile::secondsSinceProcessStart();
+    if (beforeProcessors >= 0) {
+      Startup().add("Before the processors", "", beforeProcessors);
+    }
+    // the first wrapper decides for all, deferring some inits only would change their order
+    InitThreads() = m_parallelInit;
     marlin::Global::parameters = new marlin::StringParameters();
     marlin::Global::parameters->add("AllowToModifyEvent", {"true"});
-    marlin::Global::parameters->add("RandomSeed", {"123456"});
-    // marlin::Global::EVENTSEEDER = new marlin::ProcessorEventSeeder() ;
-    if (loadProcessorLibraries().isFailure()) {
+    marlin::Global::parameters->add("RandomSeed", {std::to_string(m_randomSeed.value())});
+    if (Gaudi::Concurrency::ConcurrencyFlags::numThreads() > 1) {
+      warning() << "The random seeds of the processors are swapped in process-wide Marlin globals, they are only "
+                << "reproducible with a serial event loop" << endmsg;
+      warning() << "The streamlog name and level are process-wide, output of processors running at the same time "
+                << "may be printed with the name and level of another processor" << endmsg;
+    }
+    StartupTimer timer(Startup(), "Load libraries", "MARLIN_DLL");
+    if (m_libraryIndex.value().empty() and loadProcessorLibraries().isFailure()) {
       return StatusCode::FAILURE;
     }
   }
-
-  auto parameters = parseParameters(m_parameters, m_verbosity);
-  if (instantiateProcessor(parameters, m_processorType).isFailure()) {
+  // histograms are booked with AIDAProcessor in the init of the processors, before the fork, and its file cannot be
+  // replaced by one per worker; the workers would lose their histograms
+  if (k4MW::util::outputTagDeferred() and m_processorType.value() == "AIDAProcessor") {
+    error() << "AIDAProcessor cannot be used with NumberOfProcesses > 1, the histograms of the worker processes "
+            << "cannot be merged; use ShardCount or WorkQueue instead" << endmsg;
     return StatusCode::FAILURE;
   }
+  if (not m_libraryIndex.value().empty()) {
+    StartupTimer timer(Startup(), "Load libraries", name());
+    if (loadLibraryFor(m_processorType).isFailure()) {
+      return StatusCode::FAILURE;
+    }
+  }
+  if (not m_startupFile.value().empty()) {
+    StartupFile() = m_startupFile;
+  }
+
+  std::shared_ptr<marlin::StringParameters> parameters;
+  {
+    StartupTimer timer(Startup(), "Parse parameters", name());
+    parameters = parseParameters(taggedParameters(), m_verbosity);
+  }
+  {
+    StartupTimer timer(Startup(), "Instantiate", name());
+    if (instantiateProcessor(parameters, m_processorType).isFailure()) {
+      return StatusCode::FAILURE;
+    }
+  }
+  {
+    // Gaudi would retrieve the tools after initialize, retrieving them here includes them in the startup report
+    StartupTimer timer(Startup(), "Converter tools", name());
+    if (not m_edm_conversionTool.empty() and m_edm_conversionTool.retrieve().isFailure()) {
+      error() << "Failed to retrieve the EDM4hep to LCIO converter of " << name() << endmsg;
+      return StatusCode::FAILURE;
+    }
+    if (not m_lcio_conversionTool.empty() and m_lcio_conversionTool.retrieve().isFailure()) {
+      error() << "Failed to retrieve the LCIO to EDM4hep converter of " << name() << endmsg;
+      return StatusCode::FAILURE;
+    }
+  }
+  createEventSeeder();
+  m_logScope = k4MW::util::LogScopeToken(name(), m_verbosity);
+  if (not m_logScope.knownLevel()) {
+    warning() << "Verbosity " << m_verbosity << " of " << name() << " is not a streamlog level, it is ignored" << endmsg;
+  }
+
+  if (m_enableProfile or m_hardwareCounters or m_memoryTracking or m_costModel) {
+    m_profile = std::make_shared<k4MW::util::ProcessorProfile>(name(), m_processorType);
+    Profiles().push_back(m_profile);
+  }
+  if (m_memoryTracking) {
+    m_profile->enableMemory();
+  }
+  if (m_costModel or m_skipEmptyInputs) {
+    m_inputCollections = m_declaredInputs.value().empty() ? inputCollections() : m_declaredInputs.value();
+  }
+  if (m_costModel) {
+    m_profile->enableScaling(m_superlinearExponent);
+    if (m_inputCollections.empty()) {
+      warning() << "No input collections set in the parameters of " << name() << ", cannot fit its scaling" << endmsg;
+    }
+  }
+  if (m_skipEmptyInputs and m_inputCollections.empty()) {
+    warning() << "No input collections set in the parameters of " << name() << ", SkipEmptyInputs is ignored" << endmsg;
+  }
+  if (m_hardwareCounters) {
+    m_profile->enableCounters();
+    if (not k4MW::util::PerfCounters::forThread().hardware()) {
+      warning() << "Hardware performance counters are not available, counting page faults and context switches only"
+                << endmsg;
+    }
+  }
+  if (not m_profileFile.value().empty()) {
+    ProfileFile() = m_profileFile;
+  }
+  if (m_eventTimeBudget > 0) {
+    EventTimeBudget() = m_eventTimeBudget;
+  }
+  auto& traceRecorder = k4MW::util::TraceRecorder::instance();
+  if (not m_traceFile.value().empty()) {
+    traceRecorder.enable(m_traceFile);
+  }
+  for (int stage = 0; stage < ProcessorProfile::NStages; ++stage) {
+    const auto stageName = ProcessorProfile::stageName(ProcessorProfile::Stage(stage));
+    m_traceNames[stage]  = traceRecorder.intern(name() + ":" + stageName);
+  }
+
+  auto& exporter = k4MW::util::MetricsExporter::instance();
+  if (not m_metricsFile.value().empty()) {
+    exporter.enable(m_metricsFile, m_metricsInterval);
+  }
+  if (exporter.enabled()) {
+    // the export may have been enabled by LcioEvent, the processor series are added by the first wrapper
+    if (EventsMetric() == nullptr) {
+      EventsMetric() = &exporter.counter("k4marlinwrapper_events_processed_total", "Events through all processors",
+                                         "processors");
+      exporter.addRate(*EventsMetric(), "k4marlinwrapper_processed_per_second",
+                       "Events per second through all processors", "processors");
+    }
+    for (int stage = 0; stage < ProcessorProfile::NStages; ++stage) {
+      const auto stageName = ProcessorProfile::stageName(ProcessorProfile::Stage(stage));
+      m_metrics[stage]     = &exporter.histogram("k4marlinwrapper_processor_seconds", "Time per event of the processors",
+                                                 "processors", "processor=\"" + name() + "\",stage=\"" + stageName + "\"");
+    }
+  }
+
+  if (not m_condition.value().empty()) {
+    try {
+      m_conditionExpression.emplace(m_condition.value());
+    } catch (const std::invalid_argument& exception) {
+      error() << exception.what() << endmsg;
+      return StatusCode::FAILURE;
+    }
+    ReturnValuesUsed() = true;
+    // the processors before this one are on the stack already, below this one
+    auto earlier = ProcessorStack();
+    earlier.pop();
+    std::vector<std::string> processors;
+    for (; not earlier.empty(); earlier.pop()) {
+      processors.push_back(earlier.top()->name());
+    }
+    for (const auto& value : m_conditionExpression->names()) {
+      const bool known = std::any_of(processors.begin(), processors.end(), [&value](const auto& processor) {
+        return value == processor or value.compare(0, processor.size() + 1, processor + ".") == 0;
+      });
+#ifndef K4MARLINWRAPPER_RETURN_VALUES
+      if (known) {
+        warning() << "Condition of " << name() << " refers to " << value
+                  << ", but this Marlin does not expose the return values of processors, it is always false" << endmsg;
+      }
+#endif
+      if (not known) {
+        warning() << "Condition of " << name() << " refers to " << value << ", which is not a processor before it, "
+                  << "it is false unless an algorithm publishes it to " << ProcessorReturnValues::Location << endmsg;
+      }
+    }
+  }
+
+  // the output file of a forked worker is named after the worker, which is only known in the event loop
+  if (k4MW::util::outputTagDeferred() and m_processorType.value() == "LCIOOutputProcessor") {
+    info() << "Deferring init of " << name() << " until the worker processes are started" << endmsg;
+    m_deferredInit = true;
+    return StatusCode::SUCCESS;
+  }
+
+  if (InitThreads() > 0) {
+    if (PendingInits().empty()) {
+      k4MW::util::setStartHook([this]() { return initPendingProcessors().isSuccess(); });
+    }
+    PendingInits().push_back(this);
+    return StatusCode::SUCCESS;
+  }
+  initProcessor();
+  return StatusCode::SUCCESS;
+}
+
+void MarlinProcessorWrapper::createEventSeeder() {
+  const auto seed = processorSeed(m_randomSeed, name());
+  debug() << "Random seed for " << name() << ": " << seed << endmsg;
+  m_seedParameters = std::make_unique<marlin::StringParameters>();
+  m_seedParameters->add("RandomSeed", {std::to_string(seed)});
+  // the seeder may read RandomSeed when it is created, not only when it refreshes the seeds in modifyEvent
+  GlobalScope<marlin::StringParameters> parametersScope(marlin::Global::parameters, m_seedParameters.get());
+  m_eventSeeder = std::make_unique<marlin::ProcessorEventSeeder>();
+}
+
+std::vector<std::string> MarlinProcessorWrapper::inputCollections() const {
+  std::vector<std::string> collections;
+  std::vector<std::string> keys;
+  const auto               parameters = m_processor->parameters();
+  for (const auto& key : parameters->getStringKeys(keys)) {
+    if (m_processor->isInputCollectionName(key)) {
+      std::vector<std::string> values;
+      parameters->getStringVals(key, values);
+      collections.insert(collections.end(), values.begin(), values.end());
+    }
+  }
+  return collections;
+}
+
+std::int64_t MarlinProcessorWrapper::inputSize(const EVENT::LCEvent* event) const {
+  std::int64_t size  = 0;
+  const auto*  names = event->getCollectionNames();
+  for (const auto& collection : m_inputCollections) {
+    if (std::find(names->begin(), names->end(), collection) != names->end()) {
+      size += event->getCollection(collection)->getNumberOfElements();
+    }
+  }
+  return size;
+}
 
-  streamlog::logscope scope(streamlog::out);
-  scope.setName(name());
-  scope.setLevel(m_verbosity);
+void MarlinProcessorWrapper::initProcessor(bool concurrent) {
+  // the streamlog output is global, threads of the pool log with the scope set for the whole pool
+  if (not concurrent) {
+    m_logScope.activate();
+  }
 
   info() << "init " << endmsg;
 
-  // initialize the processor
-  m_processor->init();
+  if (concurrent) {
+    // independent processors do not use random numbers, Global::EVENTSEEDER is left alone
+    StartupTimer timer(Startup(), "Processor init (parallel)", name(), true);
+    m_processor->init();
+  } else {
+    // initialize the processor, which registers with the event seeder if it uses random numbers
+    GlobalScope<marlin::ProcessorEventSeeder> seederScope(marlin::Global::EVENTSEEDER, m_eventSeeder.get());
+    StartupTimer                              timer(Startup(), "Processor init", name());
+    m_processor->init();
+  }
 
   info() << "Init processor " << endmsg;
-  return StatusCode::SUCCESS;
+}
+
+StatusCode MarlinProcessorWrapper::initPendingProcessors() {
+  std::vector<MarlinProcessorWrapper*> independent, ordered;
+  for (auto* wrapper : PendingInits()) {
+    (wrapper->m_independentInit ? independent : ordered).push_back(wrapper);
+  }
+  PendingInits().clear();
+  const auto threads = std::min<std::size_t>(InitThreads(), independent.size());
+  info() << "Calling init of " << independent.size() << " independent processors on " << threads << " threads and of "
+         << ordered.size() << " processors in order" << endmsg;
+
+  // a thread must not leave an exception behind, it would terminate the job before the others are joined
+  std::mutex               mutex;
+  std::vector<std::string> failures;
+  auto                     init = [&mutex, &failures](MarlinProcessorWrapper* wrapper, bool concurrent) {
+    try {
+      wrapper->initProcessor(concurrent);
+    } catch (const std::exception& exception) {
+      std::lock_guard<std::mutex> lock(mutex);
+      failures.push_back(wrapper->name() + ": " + exception.what());
+    } catch (...) {
+      std::lock_guard<std::mutex> lock(mutex);
+      failures.push_back(wrapper->name() + ": unknown exception");
+    }
+  };
+
+  // the processors sharing global state keep their order, all of them before the pool starts
+  for (auto* wrapper : ordered) {
+    init(wrapper, false);
+  }
+
+  {
+    // no thread switches the streamlog name and level while the pool runs
+    k4MW::util::LogScopeToken::reset();
+    streamlog::logscope scope(streamlog::out);
+    scope.setName("ParallelInit");
+
+    StartupTimer             timer(Startup(), "Parallel init", std::to_string(threads) + " threads");
+    std::atomic<std::size_t> next{0};
+    std::vector<std::thread> pool;
+    for (std::size_t thread = 0; thread < threads; ++thread) {
+      pool.emplace_back([&independent, &next, &init]() {
+        for (auto position = next++; position < independent.size(); position = next++) {
+          init(independent[position], true);
+        }
+      });
+    }
+    for (auto& thread : pool) {
+      thread.join();
+    }
+  }
+
+  for (const auto& failure : failures) {
+    error() << "Processor init failed: " << failure << endmsg;
+  }
+  return failures.empty() ? StatusCode::SUCCESS : StatusCode::FAILURE;
 }
 
 StatusCode MarlinProcessorWrapper::execute() {
+  if (m_deferredInit) {
+    m_processor->setParameters(parseParameters(taggedParameters(), m_verbosity));
+    initProcessor();
+    m_deferredInit = false;
+  }
 
   // Get Event
-  info() << "Getting the event for " << m_processor->name() << endmsg;
+  debug() << "Getting the event for " << m_processor->name() << endmsg;
   DataObject* pObject = nullptr;
   StatusCode  sc      = eventSvc()->retrieveObject("/Event/LCEvent", pObject);
 
-  lcio::LCEventImpl* the_event = nullptr;
+  LCEventWrapper*    eventWrapper = nullptr;
+  lcio::LCEventImpl* the_event    = nullptr;
 
   if (sc.isFailure()) {
     the_event = new lcio::LCEventImpl();
     // Register empty event
     debug() << "Registering conversion EDM4hep to LCIO event in TES" << endmsg;
     auto pO = std::make_unique<LCEventWrapper>(the_event, true);
-    StatusCode reg_sc = evtSvc()->registerObject("/Event/LCEvent", pO.release());
+    StatusCode reg_sc = evtSvc()->registerObject("/Event/LCEvent", pO.get());
     if (reg_sc.isFailure()) {
       error() << "Failed to store the EDM4hep to LCIO event" << endmsg;
       return reg_sc;
     }
+    eventWrapper = pO.release();
   } else {
     debug() << "LCEvent retrieved successfully" << endmsg;
-    the_event =
-      dynamic_cast<IMPL::LCEventImpl*>(static_cast<LCEventWrapper*>(pObject)->getEvent());
+    eventWrapper = static_cast<LCEventWrapper*>(pObject);
+    the_event    = dynamic_cast<IMPL::LCEventImpl*>(eventWrapper->getEvent());
+  }
+
+  // run headers come with the events read by LcioEvent, processors see them like in Marlin, before the
+  // first event of a run, independent of the skips and conditions of the event
+  DataObject*         runObject = nullptr;
+  LCRunHeaderWrapper* runHeader = nullptr;
+  if (eventSvc()->retrieveObject(LCRunHeaderWrapper::Location, runObject).isSuccess()) {
+    runHeader = static_cast<LCRunHeaderWrapper*>(runObject);
+  }
+  GlobalScope<k4MW::util::RunCache> runCacheScope(k4MW::util::RunCache::current(),
+                                                  runHeader != nullptr ? &runHeader->runCache() : nullptr);
+  if (runHeader != nullptr and m_run != runHeader->getRunHeader()->getRunNumber()) {
+    processRunHeader(runHeader);
+  }
+
+  // a processor before this one threw SkipEventException
+  if (eventWrapper->skipped()) {
+    setFilterPassed(false);
+    completeEvent();
+    return StatusCode::SUCCESS;
+  }
+
+  if (m_conditionExpression and not conditionIsTrue()) {
+    debug() << "Condition " << m_condition.value() << " is false, skipping " << name() << endmsg;
+    ++m_conditionFalse;
+    completeEvent();
+    return StatusCode::SUCCESS;
   }
 
   // Found EDM Conversion tool
   if (!m_edm_conversionTool.empty()) {
+    StageScope stageScope(m_profile.get(), ProcessorProfile::EDM4hepToLCIO, m_traceNames, m_metrics, the_event);
     StatusCode edm_sc =  m_edm_conversionTool->convertCollections(the_event);
     if (edm_sc.isFailure()) {
-      error() << "Failed converting EDM4hep to LCIO collection " << endmsg;
+      // counted, the same failure would otherwise be reported for every event
+      Error("Failed converting EDM4hep to LCIO collection").ignore();
     }
   }
 
-  // call the refreshSeeds via the processor manager
-  // FIXME: this is an overkill, but we need to call this once per event, not once for each execute call
-  // how can this be done more efficiently?
-  auto* procMgr = marlin::ProcessorMgr::instance();
-  procMgr->modifyEvent(the_event);
+  // the scaling fit and SkipEmptyInputs need the number of input elements
+  const bool skipEmpty = m_skipEmptyInputs and not m_inputCollections.empty();
+  const auto eventSize = skipEmpty or (m_profile and m_profile->hasScaling()) ? inputSize(the_event) : -1;
+  if (skipEmpty and eventSize == 0) {
+    debug() << "All inputs of " << name() << " are empty or missing, skipping it" << endmsg;
+    ++m_emptyInputsSkipped;
+    completeEvent();
+    return StatusCode::SUCCESS;
+  }
+
+  // call the refreshSeeds of this processor's seeder via the processor manager
+  // the seeder only holds this processor, so this is needed once per execute call
+  GlobalScope<marlin::ProcessorEventSeeder> seederScope(marlin::Global::EVENTSEEDER, m_eventSeeder.get());
+  {
+    GlobalScope<marlin::StringParameters> parametersScope(marlin::Global::parameters, m_seedParameters.get());
+    marlin::ProcessorMgr::instance()->modifyEvent(the_event);
+  }
 
-  streamlog::logscope scope(streamlog::out);
-  scope.setName(name());
-  scope.setLevel(m_verbosity);
+  m_logScope.activate();
 
   //process the event in the processor
-  auto modifier = dynamic_cast<marlin::EventModifier*>(m_processor);
-  if (modifier) {
-    modifier->modifyEvent(the_event);
-  } else {
-    m_processor->processEvent(the_event);
+  auto       modifier     = dynamic_cast<marlin::EventModifier*>(m_processor);
+  const bool budgeted     = m_timeBudget > 0 or EventTimeBudget() > 0;
+  const auto processStart = budgeted ? std::chrono::steady_clock::now() : std::chrono::steady_clock::time_point();
+  {
+    StageScope stageScope(m_profile.get(), ProcessorProfile::Process, m_traceNames, m_metrics, the_event);
+    if (eventSize >= 0 and m_profile and m_profile->hasScaling()) {
+      stageScope.setInputSize(eventSize);
+    }
+    try {
+      if (modifier) {
+        modifier->modifyEvent(the_event);
+      } else {
+        m_processor->processEvent(the_event);
+      }
+    } catch (const marlin::SkipEventException&) {
+      debug() << name() << " skipped event " << the_event->getEventNumber() << " of run " << the_event->getRunNumber()
+              << endmsg;
+      ++m_skippedEvents;
+      eventWrapper->skip();
+      setFilterPassed(false);
+      completeEvent();
+      return StatusCode::SUCCESS;
+    } catch (const marlin::StopProcessingException&) {
+      info() << name() << " stopped the processing in event " << the_event->getEventNumber() << " of run "
+             << the_event->getRunNumber() << endmsg;
+      eventWrapper->skip();
+      setFilterPassed(false);
+      SmartIF<IEventProcessor> eventProcessor(serviceLocator());
+      if (eventProcessor) {
+        eventProcessor->stopRun().ignore();
+      }
+      return StatusCode::SUCCESS;
+    }
+  }
+
+  // the processor cannot be interrupted, the budget is checked once it returns
+  if (budgeted) {
+    const auto now              = std::chrono::steady_clock::now();
+    const auto processorSeconds = std::chrono::duration<double>(now - processStart).count();
+    const auto eventSeconds     = std::chrono::duration<double>(now - eventWrapper->created()).count();
+    if ((m_timeBudget > 0 and processorSeconds > m_timeBudget) or
+        (EventTimeBudget() > 0 and eventSeconds > EventTimeBudget())) {
+      dropOverBudgetEvent(eventWrapper, processorSeconds, eventSeconds);
+      completeEvent();
+      return StatusCode::SUCCESS;
+    }
   }
 
   // Found LCIO Conversion tool
   if (!m_lcio_conversionTool.empty()) {
+    StageScope stageScope(m_profile.get(), ProcessorProfile::LCIOToEDM4hep, m_traceNames, m_metrics, the_event);
     StatusCode lcio_sc =  m_lcio_conversionTool->convertCollections(the_event);
     if (lcio_sc.isFailure()) {
-      error() << "Failed converting LCIO to EDM4hep collection " << endmsg;
+      Error("Failed converting LCIO to EDM4hep collection").ignore();
+    }
+  }
+
+#ifdef K4MARLINWRAPPER_RETURN_VALUES
+  if (ReturnValuesUsed() and publishReturnValues().isFailure()) {
+    return StatusCode::FAILURE;
+  }
+#endif
+  completeEvent();
+
+  if (m_profile and m_profile->hasMemory() and not m_memoryWarned) {
+    const auto growth = m_profile->totalMemoryGrowth();
+    const auto limit  = std::int64_t(m_memoryGrowthWarning * 1024 * 1024);
+    if (growth.heap > limit or growth.rss > limit) {
+      warning() << "Memory grew by " << growth.heap / (1024 * 1024) << " MB heap and " << growth.rss / (1024 * 1024)
+                << " MB resident in " << m_profile->wall(ProcessorProfile::Process).count() << " events of " << name()
+                << endmsg;
+      m_memoryWarned = true;
     }
   }
 
   return StatusCode::SUCCESS;
 }
 
+void MarlinProcessorWrapper::processRunHeader(const LCRunHeaderWrapper* runHeader) {
+  m_run = runHeader->getRunHeader()->getRunNumber();
+  debug() << "Run header of run " << *m_run << " for " << name() << endmsg;
+  m_logScope.activate();
+  m_processor->processRunHeader(runHeader->getRunHeader());
+}
+
+bool MarlinProcessorWrapper::conditionIsTrue() {
+  DataObject* pObject = nullptr;
+  if (eventSvc()->retrieveObject(ProcessorReturnValues::Location, pObject).isFailure()) {
+    // no processor before this one set a value in this event
+    return m_conditionExpression->evaluate([](const std::string&) { return false; });
+  }
+  const auto* returnValues = static_cast<ProcessorReturnValues*>(pObject);
+  return m_conditionExpression->evaluate([returnValues](const std::string& value) { return returnValues->get(value); });
+}
+
+#ifdef K4MARLINWRAPPER_RETURN_VALUES
+StatusCode MarlinProcessorWrapper::publishReturnValues() {
+  DataObject* pObject = nullptr;
+  if (eventSvc()->retrieveObject(ProcessorReturnValues::Location, pObject).isFailure()) {
+    auto       created = std::make_unique<ProcessorReturnValues>();
+    const auto sc      = eventSvc()->registerObject(ProcessorReturnValues::Location, created.get());
+    if (sc.isFailure()) {
+      error() << "Failed to store the return values of the processors" << endmsg;
+      return sc;
+    }
+    pObject = created.release();
+  }
+  auto* returnValues = static_cast<ProcessorReturnValues*>(pObject);
+  returnValues->set(m_processor->name(), m_processor->getReturnValue());
+  for (const auto& [valueName, value] : m_processor->getReturnValues()) {
+    returnValues->set(m_processor->name() + "." + valueName, value);
+  }
+  return StatusCode::SUCCESS;
+}
+#endif
+
+void MarlinProcessorWrapper::dropOverBudgetEvent(LCEventWrapper* eventWrapper, double processorSeconds,
+                                                 double eventSeconds) {
+  const auto* event = eventWrapper->getEvent();
+  warning() << "Event " << event->getEventNumber() << " of run " << event->getRunNumber() << " took " << processorSeconds
+            << " s in " << name() << " and " << eventSeconds << " s in total, skipping the rest of it" << endmsg;
+  ++m_overBudget;
+  eventWrapper->skip();
+  setFilterPassed(false);
+
+  // one file for all processors, opened in the event loop so that forked workers write their own
+  static std::mutex           mutex;
+  static std::ofstream        file;
+  std::lock_guard<std::mutex> lock(mutex);
+  if (not file.is_open()) {
+    const auto fileName = k4MW::util::taggedFileName(m_overBudgetFile, k4MW::util::outputTag());
+    file.open(fileName);
+    if (not file) {
+      error() << "Cannot open OverBudgetFile " << fileName << endmsg;
+      return;
+    }
+    file << "# run event, skipped for going over the time budget, to be used as EventListFile\n";
+  }
+  file << event->getRunNumber() << ' ' << event->getEventNumber() << " # " << name() << ' ' << processorSeconds
+       << " s, event " << eventSeconds << " s" << std::endl;
+}
+
+void MarlinProcessorWrapper::completeEvent() const {
+  // the last processor of the chain completes the event
+  if (EventsMetric() != nullptr and ProcessorStack().top() == m_processor) {
+    k4MW::util::MetricsExporter::instance().ensureRunning();
+    EventsMetric()->add();
+  }
+}
+
+StatusCode MarlinProcessorWrapper::start() {
+  // all processors are instantiated, and initialized unless ParallelInit or the output tag defers it
+  static bool reported = false;
+  if (not reported) {
+    reported = true;
+    // without LcioEvent, or when it did not start first, the pending inits run here
+    if (not k4MW::util::runStartHook()) {
+      return StatusCode::FAILURE;
+    }
+    if (not m_libraryIndex.value().empty()) {
+      reportLibraryLoading();
+    }
+    writeStartupReport();
+  }
+  return GaudiAlgorithm::start();
+}
+
+void MarlinProcessorWrapper::writeStartupReport() const {
+  const auto measured = Startup().sequentialSeconds();
+  auto       total = k4MW::util::StartupProfile::secondsSinceProcessStart();
+  if (total < measured) {
+    total = measured;
+  } else {
+    Startup().add("Other initialization", "services and algorithms", total - measured);
+  }
+
+  std::ostringstream table;
+  k4MW::util::writeStartupTable(table, Startup(), total);
+  info() << "Startup time, longest first:\n" << table.str() << endmsg;
+
+  if (StartupFile().empty()) {
+    return;
+  }
+  std::ofstream file(StartupFile());
+  k4MW::util::writeStartupJson(file, Startup(), total);
+  if (not file) {
+    warning() << "Failed to write the startup report to " << StartupFile() << endmsg;
+  }
+}
+
 StatusCode MarlinProcessorWrapper::finalize() {
   // need to call processors in reverse order
   auto processor = ProcessorStack().top();
   ProcessorStack().pop();
   info() << "Finalising " << processor->name() << endmsg;
+  if (processor == m_processor and m_skippedEvents > 0) {
+    info() << name() << " skipped the rest of the processors in " << m_skippedEvents << " events" << endmsg;
+  }
+  if (processor == m_processor and m_skipEmptyInputs) {
+    info() << name() << " was skipped in " << m_emptyInputsSkipped << " events with empty or missing inputs" << endmsg;
+  }
+  if (processor == m_processor and m_overBudget > 0) {
+    warning() << name() << " went over the time budget in " << m_overBudget << " events, they are listed in "
+              << k4MW::util::taggedFileName(m_overBudgetFile, k4MW::util::outputTag()) << endmsg;
+  }
+  if (processor == m_processor and m_conditionExpression) {
+    info() << "Condition " << m_condition.value() << " of " << name() << " was false in " << m_conditionFalse
+           << " events" << endmsg;
+  }
 
-  streamlog::logscope scope(streamlog::out);
-  scope.setName(processor->name());
-  // Should get verbosity from actual processor being ended
-  scope.setLevel(m_verbosity);
+  {
+    streamlog::logscope scope(streamlog::out);
+    scope.setName(processor->name());
+    // Should get verbosity from actual processor being ended
+    scope.setLevel(m_verbosity);
 
-  // finalize the processor
-  processor->end();
+    if (processor == m_processor and m_deferredInit) {
+      info() << "Processor " << processor->name() << " was never initialized" << endmsg;
+    } else {
+      // finalize the processor
+      processor->end();
+    }
+  }
+  // the scope restored the name and level it found, which need not be those of the active token
+  k4MW::util::LogScopeToken::reset();
+
+  // the first processor is finalised last, when all profiles are complete
+  if (ProcessorStack().empty() and not Profiles().empty()) {
+    writeProfileReport();
+  }
+  auto& traceRecorder = k4MW::util::TraceRecorder::instance();
+  if (ProcessorStack().empty() and traceRecorder.enabled() and not traceRecorder.write()) {
+    warning() << "Failed to write the trace to " << traceRecorder.file() << endmsg;
+  }
+  if (ProcessorStack().empty() and EventsMetric() != nullptr) {
+    k4MW::util::MetricsExporter::instance().stop();
+  }
+  if (ProcessorStack().empty()) {
+    k4MW::util::AsyncLogSink::instance().stop();
+  }
 
   return Algorithm::finalize();
 }
+
+void MarlinProcessorWrapper::writeProfileReport() const {
+  std::ostringstream table;
+  k4MW::util::writeProfileTable(table, Profiles());
+  info() << "Time per processor, in ms unless noted:\n" << table.str() << endmsg;
+
+  const bool counters = std::any_of(Profiles().begin(), Profiles().end(),
+                                    [](const auto& profile) { return profile->hasCounters(); });
+  const bool memory = std::any_of(Profiles().begin(), Profiles().end(),
+                                  [](const auto& profile) { return profile->hasMemory(); });
+  if (memory) {
+    std::ostringstream memoryTable;
+    k4MW::util::writeMemoryTable(memoryTable, Profiles());
+    info() << "Memory growth per processor, in MB unless noted:\n" << memoryTable.str() << endmsg;
+  }
+  const bool scaling = std::any_of(Profiles().begin(), Profiles().end(),
+                                   [](const auto& profile) { return profile->hasScaling(); });
+  if (scaling) {
+    std::ostringstream scalingTable;
+    k4MW::util::writeScalingTable(scalingTable, Profiles());
+    info() << "Scaling of the processor time with the number of input elements, time = a * size^exponent:\n"
+           << scalingTable.str() << endmsg;
+  }
+  if (counters) {
+    std::ostringstream counterTable;
+    k4MW::util::writeCounterTable(counterTable, Profiles());
+    info() << "Performance counters of the processor calls, misses per 1000 instructions:\n"
+           << counterTable.str() << endmsg;
+  }
+
+  if (ProfileFile().empty()) {
+    return;
+  }
+  const auto    file = k4MW::util::taggedFileName(ProfileFile(), k4MW::util::outputTag());
+  std::ofstream out(file);
+  if (file.size() >= 4 and file.compare(file.size() - 4, 4, ".csv") == 0) {
+    k4MW::util::writeProfileCsv(out, Profiles());
+  } else {
+    k4MW::util::writeProfileJson(out, Profiles());
+  }
+  if (not out) {
+    warning() << "Failed to write the processor profile to " << file << endmsg;
+  } else {
+    info() << "Wrote the processor profile to " << file << endmsg;
+  }
+}
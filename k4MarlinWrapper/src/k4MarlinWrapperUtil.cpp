@@ -0,0 +1,77 @@
+/**
+ *   Copyright 2019 CERN
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ *
+ *   In applying this licence, CERN does not waive the privileges and immunities
+ *   granted to it by virtue of its status as an Intergovernmental Organization
+ *   or submit itself to any jurisdiction.
+ *
+ */
+
+// State shared by LcioEvent and the processor wrappers. Both component libraries link this
+// library, so there is exactly one copy of it however the component libraries are loaded.
+
+#include "k4MarlinWrapper/util/k4MarlinWrapperUtil.h"
+#include "k4MarlinWrapper/util/MetricsExporter.h"
+#include "k4MarlinWrapper/util/TraceRecorder.h"
+
+namespace k4MW::util {
+
+namespace {
+  struct JobState {
+    std::string outputTag;
+    bool        outputTagDeferred = false;
+    int         workerIndex       = 0;
+
+    std::function<bool()> startHook;
+  };
+
+  JobState& jobState() {
+    static JobState state;
+    return state;
+  }
+}
+
+std::string outputTag() { return jobState().outputTag; }
+
+void setOutputTag(const std::string& tag) { jobState().outputTag = tag; }
+
+bool outputTagDeferred() { return jobState().outputTagDeferred; }
+
+void setOutputTagDeferred() { jobState().outputTagDeferred = true; }
+
+int workerIndex() { return jobState().workerIndex; }
+
+void setWorkerIndex(int worker) { jobState().workerIndex = worker; }
+
+void setStartHook(std::function<bool()> hook) { jobState().startHook = std::move(hook); }
+
+bool runStartHook() {
+  // taken out first, the hook runs once however many algorithms call it
+  auto hook = std::move(jobState().startHook);
+  jobState().startHook = nullptr;
+  return not hook or hook();
+}
+
+TraceRecorder& TraceRecorder::instance() {
+  static TraceRecorder recorder;
+  return recorder;
+}
+
+MetricsExporter& MetricsExporter::instance() {
+  static MetricsExporter exporter;
+  return exporter;
+}
+
+}
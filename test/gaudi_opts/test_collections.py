@@ -0,0 +1,24 @@
+from Gaudi.Configuration import *
+
+from Configurables import LcioEvent, EventDataSvc, TestEventRecorder
+algList = []
+evtsvc = EventDataSvc()
+
+# the test script selects the collections to decode with --option
+read = LcioEvent()
+read.OutputLevel = INFO
+read.Files = ["$k4MarlinWrapper_tests_DIR/inputFiles/testSimulation.slcio"]
+algList.append(read)
+
+recorder = TestEventRecorder("Recorder")
+recorder.PrintCollections = True
+algList.append(recorder)
+
+
+from Configurables import ApplicationMgr
+ApplicationMgr( TopAlg = algList,
+                EvtSel = 'NONE',
+                EvtMax   = 3,
+                ExtSvc = [evtsvc],
+                OutputLevel=INFO
+)
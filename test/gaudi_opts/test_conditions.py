@@ -0,0 +1,39 @@
+from Gaudi.Configuration import *
+
+from Configurables import LcioEvent, EventDataSvc, MarlinProcessorWrapper, TestReturnValues
+algList = []
+evtsvc = EventDataSvc()
+
+read = LcioEvent()
+read.OutputLevel = DEBUG
+read.Files = ["$k4MarlinWrapper_tests_DIR/inputFiles/muons.slcio"]
+algList.append(read)
+
+# stands in for a processor returning true, with a named value returning false
+selection = TestReturnValues("Filter")
+selection.TrueValues = ["Filter"]
+selection.FalseValues = ["Filter.isBackground"]
+algList.append(selection)
+
+conditions = {"AndNot": "Filter && !Filter.isBackground",
+              "Or": "Filter.isBackground || !Filter",
+              "Parentheses": "!(Filter.isBackground || !Filter) && (Filter || Filter.isBackground)",
+              }
+for name, condition in conditions.items():
+  proc = MarlinProcessorWrapper(name)
+  proc.OutputLevel = DEBUG
+  proc.ProcessorType = "Statusmonitor"
+  proc.Condition = condition
+  proc.Parameters = {"HowOften": ["1"],
+                     "Verbosity": ["DEBUG"],
+                     }
+  algList.append(proc)
+
+
+from Configurables import ApplicationMgr
+ApplicationMgr( TopAlg = algList,
+                EvtSel = 'NONE',
+                EvtMax   = 3,
+                ExtSvc = [evtsvc],
+                OutputLevel=DEBUG
+)
@@ -0,0 +1,32 @@
+from Gaudi.Configuration import *
+
+from Configurables import LcioEvent, EventDataSvc, MarlinProcessorWrapper, TestEventRecorder
+algList = []
+evtsvc = EventDataSvc()
+
+# the test scripts split the events into shards or worker processes with --option
+read = LcioEvent()
+read.OutputLevel = INFO
+read.Files = ["$k4MarlinWrapper_tests_DIR/inputFiles/muons.slcio"]
+read.ChunkSize = 2
+algList.append(read)
+
+recorder = TestEventRecorder("Recorder")
+algList.append(recorder)
+
+proc0 = MarlinProcessorWrapper("EventNumber")
+proc0.OutputLevel = INFO
+proc0.ProcessorType = "Statusmonitor"
+proc0.Parameters = {"HowOften": ["1"],
+                    "Verbosity": ["MESSAGE"],
+                    }
+algList.append(proc0)
+
+
+from Configurables import ApplicationMgr
+ApplicationMgr( TopAlg = algList,
+                EvtSel = 'NONE',
+                EvtMax   = -1,
+                ExtSvc = [evtsvc],
+                OutputLevel=INFO
+)
@@ -0,0 +1,33 @@
+from Gaudi.Configuration import *
+
+from Configurables import LcioEvent, EventDataSvc, MarlinProcessorWrapper, TestEventRecorder
+algList = []
+evtsvc = EventDataSvc()
+
+read = LcioEvent()
+read.OutputLevel = DEBUG
+read.Files = ["$k4MarlinWrapper_tests_DIR/inputFiles/muons.slcio"]
+read.EventsInFlight = 3
+read.DropCollections = ["MCParticle"]
+read.SkipEvents = 2
+algList.append(read)
+
+recorder = TestEventRecorder("Recorder")
+algList.append(recorder)
+
+proc0 = MarlinProcessorWrapper("EventNumber")
+proc0.OutputLevel = DEBUG
+proc0.ProcessorType = "Statusmonitor"
+proc0.Parameters = {"HowOften": ["1"],
+                    "Verbosity": ["DEBUG"],
+                    }
+algList.append(proc0)
+
+
+from Configurables import ApplicationMgr
+ApplicationMgr( TopAlg = algList,
+                EvtSel = 'NONE',
+                EvtMax   = 5,
+                ExtSvc = [evtsvc],
+                OutputLevel=DEBUG
+)
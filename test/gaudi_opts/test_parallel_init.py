@@ -0,0 +1,31 @@
+from Gaudi.Configuration import *
+
+from Configurables import LcioEvent, EventDataSvc, MarlinProcessorWrapper
+algList = []
+evtsvc = EventDataSvc()
+
+read = LcioEvent()
+read.OutputLevel = INFO
+read.Files = ["$k4MarlinWrapper_tests_DIR/inputFiles/muons.slcio"]
+algList.append(read)
+
+# the test script sets ParallelInit on the first wrapper with --option, the processors with
+# IndependentInit are then initialized on a thread pool, the others in order
+for name, independent in [("First", False), ("Independent1", True), ("Second", False),
+                          ("Independent2", True), ("Independent3", True), ("Third", False)]:
+    proc = MarlinProcessorWrapper(name)
+    proc.OutputLevel = INFO
+    proc.ProcessorType = "TestActionProcessor"
+    proc.IndependentInit = independent
+    proc.Parameters = {"Verbosity": ["MESSAGE"],
+                       }
+    algList.append(proc)
+
+
+from Configurables import ApplicationMgr
+ApplicationMgr( TopAlg = algList,
+                EvtSel = 'NONE',
+                EvtMax   = 3,
+                ExtSvc = [evtsvc],
+                OutputLevel=INFO
+)
@@ -0,0 +1,49 @@
+from Gaudi.Configuration import *
+
+from Configurables import LcioEvent, EventDataSvc, MarlinProcessorWrapper
+algList = []
+evtsvc = EventDataSvc()
+
+read = LcioEvent()
+read.OutputLevel = INFO
+read.Files = ["$k4MarlinWrapper_tests_DIR/inputFiles/muons.slcio"]
+algList.append(read)
+
+# the test script changes the ProfileFile to CSV with --option
+maker = MarlinProcessorWrapper("Maker")
+maker.OutputLevel = INFO
+maker.ProcessorType = "TestActionProcessor"
+maker.Profile = True
+maker.ProfileFile = "profile.json"
+maker.StartupFile = "startup.json"
+maker.Parameters = {"FilledCollections": ["FilledHits"],
+                    "Verbosity": ["MESSAGE"],
+                    }
+algList.append(maker)
+
+sized = MarlinProcessorWrapper("Sized")
+sized.OutputLevel = INFO
+sized.ProcessorType = "TestActionProcessor"
+sized.MemoryTracking = True
+sized.CostModel = True
+sized.InputCollections = ["FilledHits"]
+sized.Parameters = {"Verbosity": ["MESSAGE"],
+                    }
+algList.append(sized)
+
+counted = MarlinProcessorWrapper("Counted")
+counted.OutputLevel = INFO
+counted.ProcessorType = "TestActionProcessor"
+counted.HardwareCounters = True
+counted.Parameters = {"Verbosity": ["MESSAGE"],
+                      }
+algList.append(counted)
+
+
+from Configurables import ApplicationMgr
+ApplicationMgr( TopAlg = algList,
+                EvtSel = 'NONE',
+                EvtMax   = 4,
+                ExtSvc = [evtsvc],
+                OutputLevel=INFO
+)
@@ -0,0 +1,29 @@
+from Gaudi.Configuration import *
+
+from Configurables import LcioEvent, EventDataSvc, MarlinProcessorWrapper
+algList = []
+evtsvc = EventDataSvc()
+
+# written by test_two_runs.py
+read = LcioEvent()
+read.OutputLevel = INFO
+read.Files = ["two_runs.slcio"]
+read.RunHeaders = True
+algList.append(read)
+
+check = MarlinProcessorWrapper("Check")
+check.OutputLevel = INFO
+check.ProcessorType = "TestActionProcessor"
+check.Parameters = {"PrintRuns": ["true"],
+                    "Verbosity": ["MESSAGE"],
+                    }
+algList.append(check)
+
+
+from Configurables import ApplicationMgr
+ApplicationMgr( TopAlg = algList,
+                EvtSel = 'NONE',
+                EvtMax   = -1,
+                ExtSvc = [evtsvc],
+                OutputLevel=INFO
+)
@@ -0,0 +1,29 @@
+from Gaudi.Configuration import *
+
+from Configurables import LcioEvent, EventDataSvc, MarlinProcessorWrapper
+algList = []
+evtsvc = EventDataSvc()
+
+# the test script splits the events into shards or worker processes with --option
+read = LcioEvent()
+read.OutputLevel = INFO
+read.Files = ["$k4MarlinWrapper_tests_DIR/inputFiles/muons.slcio"]
+read.ChunkSize = 2
+algList.append(read)
+
+proc0 = MarlinProcessorWrapper("Seeds")
+proc0.OutputLevel = INFO
+proc0.ProcessorType = "TestSeedProcessor"
+proc0.RandomSeed = 4711
+proc0.Parameters = {"Verbosity": ["MESSAGE"],
+                    }
+algList.append(proc0)
+
+
+from Configurables import ApplicationMgr
+ApplicationMgr( TopAlg = algList,
+                EvtSel = 'NONE',
+                EvtMax   = -1,
+                ExtSvc = [evtsvc],
+                OutputLevel=INFO
+)
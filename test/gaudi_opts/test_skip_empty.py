@@ -0,0 +1,57 @@
+from Gaudi.Configuration import *
+
+from Configurables import LcioEvent, EventDataSvc, MarlinProcessorWrapper
+algList = []
+evtsvc = EventDataSvc()
+
+read = LcioEvent()
+read.OutputLevel = INFO
+read.Files = ["$k4MarlinWrapper_tests_DIR/inputFiles/muons.slcio"]
+algList.append(read)
+
+maker = MarlinProcessorWrapper("Maker")
+maker.OutputLevel = INFO
+maker.ProcessorType = "TestActionProcessor"
+maker.Parameters = {"EmptyCollections": ["EmptyHits"],
+                    "FilledCollections": ["FilledHits"],
+                    "Verbosity": ["MESSAGE"],
+                    }
+algList.append(maker)
+
+# skipped in every event, their inputs are empty or missing
+emptyInput = MarlinProcessorWrapper("EmptyInput")
+emptyInput.OutputLevel = INFO
+emptyInput.ProcessorType = "TestActionProcessor"
+emptyInput.SkipEmptyInputs = True
+emptyInput.InputCollections = ["EmptyHits"]
+emptyInput.Parameters = {"Verbosity": ["MESSAGE"],
+                         }
+algList.append(emptyInput)
+
+missingInput = MarlinProcessorWrapper("MissingInput")
+missingInput.OutputLevel = INFO
+missingInput.ProcessorType = "TestActionProcessor"
+missingInput.SkipEmptyInputs = True
+missingInput.InputCollections = ["MissingHits"]
+missingInput.Parameters = {"Verbosity": ["MESSAGE"],
+                           }
+algList.append(missingInput)
+
+# runs in every event, one of its inputs has a hit
+mixedInput = MarlinProcessorWrapper("MixedInput")
+mixedInput.OutputLevel = INFO
+mixedInput.ProcessorType = "TestActionProcessor"
+mixedInput.SkipEmptyInputs = True
+mixedInput.InputCollections = ["EmptyHits", "MissingHits", "FilledHits"]
+mixedInput.Parameters = {"Verbosity": ["MESSAGE"],
+                         }
+algList.append(mixedInput)
+
+
+from Configurables import ApplicationMgr
+ApplicationMgr( TopAlg = algList,
+                EvtSel = 'NONE',
+                EvtMax   = 5,
+                ExtSvc = [evtsvc],
+                OutputLevel=INFO
+)
@@ -0,0 +1,41 @@
+from Gaudi.Configuration import *
+
+from Configurables import LcioEvent, EventDataSvc, MarlinProcessorWrapper, TestEventRecorder, GaudiSequencer
+algList = []
+evtsvc = EventDataSvc()
+
+read = LcioEvent()
+read.OutputLevel = INFO
+read.Files = ["$k4MarlinWrapper_tests_DIR/inputFiles/muons.slcio"]
+algList.append(read)
+
+# skips the second and fourth event and stops the job in the fifth
+skipper = MarlinProcessorWrapper("Skipper")
+skipper.OutputLevel = INFO
+skipper.ProcessorType = "TestActionProcessor"
+skipper.Parameters = {"SkipEvery": ["2"],
+                      "StopAt": ["5"],
+                      "Verbosity": ["MESSAGE"],
+                      }
+
+# the sequencer only runs the recorder in events where the skipper passed the filter
+recorder = TestEventRecorder("Recorder")
+filtered = GaudiSequencer("Filtered")
+filtered.Members = [skipper, recorder]
+algList.append(filtered)
+
+after = MarlinProcessorWrapper("After")
+after.OutputLevel = INFO
+after.ProcessorType = "TestActionProcessor"
+after.Parameters = {"Verbosity": ["MESSAGE"],
+                    }
+algList.append(after)
+
+
+from Configurables import ApplicationMgr
+ApplicationMgr( TopAlg = algList,
+                EvtSel = 'NONE',
+                EvtMax   = -1,
+                ExtSvc = [evtsvc],
+                OutputLevel=INFO
+)
@@ -0,0 +1,38 @@
+from Gaudi.Configuration import *
+
+from Configurables import LcioEvent, EventDataSvc, MarlinProcessorWrapper
+algList = []
+evtsvc = EventDataSvc()
+
+read = LcioEvent()
+read.OutputLevel = INFO
+read.Files = ["$k4MarlinWrapper_tests_DIR/inputFiles/muons.slcio"]
+algList.append(read)
+
+# goes over its budget in the second and fourth event
+slow = MarlinProcessorWrapper("Slow")
+slow.OutputLevel = INFO
+slow.ProcessorType = "TestActionProcessor"
+slow.TimeBudget = 0.2
+slow.OverBudgetFile = "time_budget_events.txt"
+slow.Parameters = {"SleepEvery": ["2"],
+                   "SleepMilliseconds": ["600"],
+                   "Verbosity": ["MESSAGE"],
+                   }
+algList.append(slow)
+
+after = MarlinProcessorWrapper("After")
+after.OutputLevel = INFO
+after.ProcessorType = "TestActionProcessor"
+after.Parameters = {"Verbosity": ["MESSAGE"],
+                    }
+algList.append(after)
+
+
+from Configurables import ApplicationMgr
+ApplicationMgr( TopAlg = algList,
+                EvtSel = 'NONE',
+                EvtMax   = 5,
+                ExtSvc = [evtsvc],
+                OutputLevel=INFO
+)
@@ -0,0 +1,29 @@
+from Gaudi.Configuration import *
+
+from Configurables import LcioEvent, EventDataSvc, MarlinProcessorWrapper
+algList = []
+evtsvc = EventDataSvc()
+
+read = LcioEvent()
+read.OutputLevel = INFO
+read.Files = ["$k4MarlinWrapper_tests_DIR/inputFiles/muons.slcio"]
+algList.append(read)
+
+# copies the events into two runs of three events, the input of test_run_headers.py
+writer = MarlinProcessorWrapper("Writer")
+writer.OutputLevel = INFO
+writer.ProcessorType = "TestActionProcessor"
+writer.Parameters = {"CopyFile": ["two_runs.slcio"],
+                     "CopyRunLength": ["3"],
+                     "Verbosity": ["MESSAGE"],
+                     }
+algList.append(writer)
+
+
+from Configurables import ApplicationMgr
+ApplicationMgr( TopAlg = algList,
+                EvtSel = 'NONE',
+                EvtMax   = 6,
+                ExtSvc = [evtsvc],
+                OutputLevel=INFO
+)
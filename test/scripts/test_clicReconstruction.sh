@@ -25,13 +25,13 @@ echo "Modifying clicReconstruction.py file..."
 # Replace SLCIO file path
 # sed -i 's|/run/simulation/with/ctest/to/create/a/file.slcio|testSimulation.slcio|g' clicReconstruction.py
 sed -i 's|/run/simulation/with/ctest/to/create/a/file.slcio|$k4MarlinWrapper_tests_DIR/inputFiles/testSimulation.slcio|g' clicReconstruction.py
-# Uncomment selected optional processors
 sed -i 's;EvtMax   = 10,;EvtMax   = 3,;' clicReconstruction.py
 sed -i 's;"MaxRecordNumber": ["10"],;"MaxRecordNumber": ["3"],;' clicReconstruction.py
-sed -i 's;# algList.append(OverlayFalse);algList.append(OverlayFalse);' clicReconstruction.py
-sed -i 's;# algList.append(MyConformalTracking);algList.append(MyConformalTracking);' clicReconstruction.py
-sed -i 's;# algList.append(ClonesAndSplitTracksFinder);algList.append(ClonesAndSplitTracksFinder);' clicReconstruction.py
-sed -i 's;# algList.append(RenameCollection);algList.append(RenameCollection);' clicReconstruction.py
+# Always run selected optional processors, whatever the Config processor returns
+sed -i '/^OverlayFalse.Condition = /d' clicReconstruction.py
+sed -i '/^MyConformalTracking.Condition = /d' clicReconstruction.py
+sed -i '/^ClonesAndSplitTracksFinder.Condition = /d' clicReconstruction.py
+sed -i '/^RenameCollection.Condition = /d' clicReconstruction.py
 sed -i 's;"DD4hepXMLFile", ".*",; "DD4hepXMLFile", os.environ["LCGEO"]+"/CLIC/compact/CLIC_o3_v14/CLIC_o3_v14.xml",;' clicReconstruction.py
 # Change output level for correct test confirmation
 sed -i 's;OutputLevel=WARNING; OutputLevel=DEBUG;' clicReconstruction.py
@@ -0,0 +1,60 @@
+#!/bin/bash
+set -eu
+set -o pipefail
+
+if [ ! -d $k4MarlinWrapper_tests_DIR/inputFiles/ ]; then
+  mkdir $k4MarlinWrapper_tests_DIR/inputFiles
+fi
+
+if [ ! -f $k4MarlinWrapper_tests_DIR/inputFiles/testSimulation.slcio ]; then
+  wget https://key4hep.web.cern.ch/testFiles/ddsimOutput/testSimulation.slcio -P $k4MarlinWrapper_tests_DIR/inputFiles/
+fi
+
+OPTS=$k4MarlinWrapper_tests_DIR/gaudi_opts/test_collections.py
+
+# one line per event with the sorted names of its decoded collections
+collections() {
+  grep -o "Collections of run [0-9]* event [0-9]*:.*" | sed 's/ *$//'
+}
+
+# expected lines: only the names given as arguments that are present in the event
+only() {
+  local keep=" $* "
+  while read -r event; do
+    local line="${event%%:*}:"
+    for name in ${event#*:}; do
+      if [[ "$keep" == *" $name "* ]]; then
+        line="$line $name"
+      fi
+    done
+    echo "$line"
+  done
+}
+
+# every collection of the input
+../run gaudirun.py $OPTS | collections > collections_all.txt
+test -s collections_all.txt
+
+FIRST=$(head -n 1 collections_all.txt | cut -d: -f2)
+set -- $FIRST
+if [ $# -lt 3 ]; then
+  echo "The input needs at least three collections in its first event"
+  exit 1
+fi
+DROP=$1
+KEEP="$2 $3"
+
+# DropCollections removes the dropped collection and keeps the other ones of the first event
+../run gaudirun.py $OPTS --option "from Configurables import LcioEvent; LcioEvent().DropCollections = ['$DROP']" \
+  | collections > collections_dropped.txt
+only $(echo "$FIRST" | sed "s/ $DROP\b//") < collections_all.txt | diff - collections_dropped.txt
+if grep -q " $DROP\b" collections_dropped.txt; then
+  echo "The dropped collection $DROP was decoded"
+  exit 1
+fi
+
+# Collections restricts the decoded collections to the selected ones
+../run gaudirun.py $OPTS --option "from Configurables import LcioEvent; LcioEvent().Collections = ['${KEEP// /\', \'}']" \
+  | collections > collections_selected.txt
+only $KEEP < collections_all.txt | diff - collections_selected.txt
+echo "Dropped $DROP and selected $KEEP in $(wc -l < collections_all.txt) events"
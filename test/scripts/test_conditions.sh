@@ -0,0 +1,18 @@
+#!/bin/bash
+set -eu
+set -o pipefail
+
+if [ ! -d $k4MarlinWrapper_tests_DIR/inputFiles/ ]; then
+  mkdir $k4MarlinWrapper_tests_DIR/inputFiles
+fi
+
+if [ ! -f $k4MarlinWrapper_tests_DIR/inputFiles/muons.slcio ]; then
+  wget https://github.com/AIDASoft/DD4hep/raw/master/DDTest/inputFiles/muons.slcio -P $k4MarlinWrapper_tests_DIR/inputFiles/
+fi
+
+../run gaudirun.py $k4MarlinWrapper_tests_DIR/gaudi_opts/test_conditions.py | tee test_conditions.log
+
+# the processors run in all 3 events unless their condition is false
+grep -F "of AndNot was false in 0 events" test_conditions.log
+grep -F "of Or was false in 3 events" test_conditions.log
+grep -F "of Parentheses was false in 0 events" test_conditions.log
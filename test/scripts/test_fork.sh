@@ -0,0 +1,34 @@
+#!/bin/bash
+set -eu
+set -o pipefail
+
+if [ ! -d $k4MarlinWrapper_tests_DIR/inputFiles/ ]; then
+  mkdir $k4MarlinWrapper_tests_DIR/inputFiles
+fi
+
+if [ ! -f $k4MarlinWrapper_tests_DIR/inputFiles/muons.slcio ]; then
+  wget https://github.com/AIDASoft/DD4hep/raw/master/DDTest/inputFiles/muons.slcio -P $k4MarlinWrapper_tests_DIR/inputFiles/
+fi
+
+SPLITS=$k4MarlinWrapper_tests_DIR/gaudi_opts/test_event_splits.py
+
+# the run and event numbers of the processed events, in the order they were processed
+events() {
+  grep -o "Recorded run [0-9]* event [0-9]*"
+}
+
+# every event of the input, read in order by a single process
+../run gaudirun.py $SPLITS | events > fork_all.txt
+test -s fork_all.txt
+
+../run gaudirun.py $SPLITS --option "from Configurables import LcioEvent; LcioEvent().NumberOfProcesses = 3" | events > fork_workers.txt
+
+# the workers take chunks in any order, but every event exactly once
+sort fork_all.txt > fork_all_sorted.txt
+sort fork_workers.txt | diff fork_all_sorted.txt -
+
+# EvtMax limits the events of the whole job, the first four of the input
+../run gaudirun.py $SPLITS --option "from Configurables import LcioEvent, ApplicationMgr; LcioEvent().NumberOfProcesses = 3; ApplicationMgr().EvtMax = 4" | events > fork_evtmax.txt
+head -n 4 fork_all.txt | sort > fork_first.txt
+sort fork_evtmax.txt | diff fork_first.txt -
+echo "The worker processes processed the $(wc -l < fork_workers.txt) expected events"
@@ -0,0 +1,28 @@
+#!/bin/bash
+set -eu
+set -o pipefail
+
+if [ ! -d $k4MarlinWrapper_tests_DIR/inputFiles/ ]; then
+  mkdir $k4MarlinWrapper_tests_DIR/inputFiles
+fi
+
+if [ ! -f $k4MarlinWrapper_tests_DIR/inputFiles/muons.slcio ]; then
+  wget https://github.com/AIDASoft/DD4hep/raw/master/DDTest/inputFiles/muons.slcio -P $k4MarlinWrapper_tests_DIR/inputFiles/
+fi
+
+SPLITS=$k4MarlinWrapper_tests_DIR/gaudi_opts/test_event_splits.py
+
+# the run and event numbers of the processed events, in the order they were processed
+events() {
+  grep -o "Recorded run [0-9]* event [0-9]*"
+}
+
+# every event of the input, read in order by a single process
+../run gaudirun.py $SPLITS | events > reader_all.txt
+test -s reader_all.txt
+
+../run gaudirun.py $k4MarlinWrapper_tests_DIR/gaudi_opts/test_lcio_reader.py | events > reader_selected.txt
+
+# SkipEvents = 2 and EvtMax = 5 select the third to the seventh event of the input
+sed -n 3,7p reader_all.txt | diff - reader_selected.txt
+echo "Processed the $(wc -l < reader_selected.txt) expected events"
@@ -0,0 +1,43 @@
+#!/bin/bash
+set -eu
+set -o pipefail
+
+if [ ! -d $k4MarlinWrapper_tests_DIR/inputFiles/ ]; then
+  mkdir $k4MarlinWrapper_tests_DIR/inputFiles
+fi
+
+if [ ! -f $k4MarlinWrapper_tests_DIR/inputFiles/muons.slcio ]; then
+  wget https://github.com/AIDASoft/DD4hep/raw/master/DDTest/inputFiles/muons.slcio -P $k4MarlinWrapper_tests_DIR/inputFiles/
+fi
+
+export MARLIN_DLL=${MARLIN_DLL:+$MARLIN_DLL:}$TestActionProcessor_LIB
+OPTIONS=$k4MarlinWrapper_tests_DIR/gaudi_opts/test_parallel_init.py
+
+inits() {
+  grep -o "Init of [A-Za-z0-9]*" $1
+}
+
+processed() {
+  grep -o "[A-Za-z0-9]* processed run [0-9]* event [0-9]*" $1
+}
+
+../run gaudirun.py $OPTIONS > parallel_init_serial.log
+PARALLEL="from Configurables import MarlinProcessorWrapper; MarlinProcessorWrapper('First').ParallelInit = 2"
+../run gaudirun.py $OPTIONS --option "$PARALLEL" > parallel_init_parallel.log
+grep -q "Processor init (parallel)" parallel_init_parallel.log
+
+# without ParallelInit, the processors are initialized in the order of the sequence
+inits parallel_init_serial.log > parallel_init_serial.txt
+printf "Init of %s\n" First Independent1 Second Independent2 Independent3 Third | diff - parallel_init_serial.txt
+
+# with it, every processor is initialized once, the ordered ones keep their order
+inits parallel_init_parallel.log > parallel_init_parallel.txt
+diff <(sort parallel_init_serial.txt) <(sort parallel_init_parallel.txt)
+diff <(grep -v Independent parallel_init_serial.txt) <(grep -v Independent parallel_init_parallel.txt)
+
+# all inits are done before the first event, and the events are processed the same way
+lastInit=$(grep -n "Init of " parallel_init_parallel.log | tail -n 1 | cut -d: -f1)
+firstEvent=$(grep -n " processed run " parallel_init_parallel.log | head -n 1 | cut -d: -f1)
+test $lastInit -lt $firstEvent
+processed parallel_init_serial.log | diff - <(processed parallel_init_parallel.log)
+echo "The $(wc -l < parallel_init_parallel.txt) processors were initialized before the first event"
@@ -0,0 +1,45 @@
+#!/bin/bash
+set -eu
+set -o pipefail
+
+if [ ! -d $k4MarlinWrapper_tests_DIR/inputFiles/ ]; then
+  mkdir $k4MarlinWrapper_tests_DIR/inputFiles
+fi
+
+if [ ! -f $k4MarlinWrapper_tests_DIR/inputFiles/muons.slcio ]; then
+  wget https://github.com/AIDASoft/DD4hep/raw/master/DDTest/inputFiles/muons.slcio -P $k4MarlinWrapper_tests_DIR/inputFiles/
+fi
+
+export MARLIN_DLL=${MARLIN_DLL:+$MARLIN_DLL:}$TestActionProcessor_LIB
+OPTIONS=$k4MarlinWrapper_tests_DIR/gaudi_opts/test_profile.py
+
+rm -f profile.json profile.csv startup.json
+../run gaudirun.py $OPTIONS
+CSV="from Configurables import MarlinProcessorWrapper; MarlinProcessorWrapper('Maker').ProfileFile = 'profile.csv'"
+../run gaudirun.py $OPTIONS --option "$CSV"
+
+# the files parse and list every processor, with the 4 events of the job
+python - <<'END'
+import csv
+import json
+
+processors = {"Maker", "Sized", "Counted"}
+
+profile = json.load(open("profile.json"))
+assert {p["name"] for p in profile["processors"]} == processors, profile
+for p in profile["processors"]:
+    assert p["stages"]["Process"]["calls"] == 4, p
+    assert p["stages"]["Process"]["wall_p50"] <= p["stages"]["Process"]["wall_max"], p
+    assert ("heap_growth" in p["stages"]["Process"]) == (p["name"] == "Sized"), p
+    assert all(isinstance(value, int) for value in p.get("counters", {}).values()), p
+
+rows = list(csv.DictReader(open("profile.csv")))
+assert {row["processor"] for row in rows} == processors, rows
+assert all(int(row["calls"]) == 4 for row in rows if row["stage"] == "Process"), rows
+assert "scaling_exponent" in rows[0], rows[0]
+
+startup = json.load(open("startup.json"))
+assert processors <= {phase["component"] for phase in startup["phases"]}, startup
+assert startup["total"] >= max(phase["seconds"] for phase in startup["phases"]), startup
+print("The profile and startup files list the", len(processors), "processors")
+END
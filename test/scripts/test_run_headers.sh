@@ -0,0 +1,39 @@
+#!/bin/bash
+set -eu
+set -o pipefail
+
+if [ ! -d $k4MarlinWrapper_tests_DIR/inputFiles/ ]; then
+  mkdir $k4MarlinWrapper_tests_DIR/inputFiles
+fi
+
+if [ ! -f $k4MarlinWrapper_tests_DIR/inputFiles/muons.slcio ]; then
+  wget https://github.com/AIDASoft/DD4hep/raw/master/DDTest/inputFiles/muons.slcio -P $k4MarlinWrapper_tests_DIR/inputFiles/
+fi
+
+export MARLIN_DLL=${MARLIN_DLL:+$MARLIN_DLL:}$TestActionProcessor_LIB
+OPTIONS=$k4MarlinWrapper_tests_DIR/gaudi_opts/test_run_headers.py
+
+# the run headers, events and run caches the check processor saw, in order
+calls() {
+  grep -oE "Check (run header of run [0-9]+|processed run [0-9]+ event [0-9]+|has (the|no) run cache( of run [0-9]+)?)"
+}
+
+# two runs of three events
+rm -f two_runs.slcio
+../run gaudirun.py $k4MarlinWrapper_tests_DIR/gaudi_opts/test_two_runs.py | grep -o "Writer wrote run [0-9]* event [0-9]*" \
+  > run_headers_written.txt
+test $(wc -l < run_headers_written.txt) -eq 6
+
+# with RunHeaders, processRunHeader is called before the first event of each run, and the run cache
+# of the event is set while the processor runs
+awk '$4 != run { run = $4; print "Check run header of run " run }
+     { print "Check processed run " $4 " event " $6; print "Check has the run cache of run " $4 }' \
+  run_headers_written.txt > run_headers_expected.txt
+../run gaudirun.py $OPTIONS | calls | diff run_headers_expected.txt -
+
+# without them, there are neither run headers nor run caches
+awk '{ print "Check processed run " $4 " event " $6; print "Check has no run cache" }' \
+  run_headers_written.txt > run_headers_expected_off.txt
+../run gaudirun.py $OPTIONS --option "from Configurables import LcioEvent; LcioEvent().RunHeaders = False" | calls \
+  | diff run_headers_expected_off.txt -
+echo "processRunHeader was called for the $(grep -c header run_headers_expected.txt) runs of the input"
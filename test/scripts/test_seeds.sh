@@ -0,0 +1,31 @@
+#!/bin/bash
+set -eu
+set -o pipefail
+
+if [ ! -d $k4MarlinWrapper_tests_DIR/inputFiles/ ]; then
+  mkdir $k4MarlinWrapper_tests_DIR/inputFiles
+fi
+
+if [ ! -f $k4MarlinWrapper_tests_DIR/inputFiles/muons.slcio ]; then
+  wget https://github.com/AIDASoft/DD4hep/raw/master/DDTest/inputFiles/muons.slcio -P $k4MarlinWrapper_tests_DIR/inputFiles/
+fi
+
+export MARLIN_DLL=${MARLIN_DLL:+$MARLIN_DLL:}$TestSeedProcessor_LIB
+OPTIONS=$k4MarlinWrapper_tests_DIR/gaudi_opts/test_seeds.py
+
+# the seed of every event, in the order of run and event number
+seeds() {
+  grep -o "Seed of run [0-9]* event [0-9]*: [0-9]*" | sort
+}
+
+../run gaudirun.py $OPTIONS | seeds > seeds_all.txt
+{
+  ../run gaudirun.py $OPTIONS --option "from Configurables import LcioEvent; LcioEvent().ShardCount = 2; LcioEvent().ShardIndex = 0"
+  ../run gaudirun.py $OPTIONS --option "from Configurables import LcioEvent; LcioEvent().ShardCount = 2; LcioEvent().ShardIndex = 1"
+} | seeds > seeds_shards.txt
+../run gaudirun.py $OPTIONS --option "from Configurables import LcioEvent; LcioEvent().NumberOfProcesses = 3" | seeds > seeds_workers.txt
+
+test -s seeds_all.txt
+diff seeds_all.txt seeds_shards.txt
+diff seeds_all.txt seeds_workers.txt
+echo "The seeds of $(wc -l < seeds_all.txt) events do not depend on how the events are split"
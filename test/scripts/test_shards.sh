@@ -0,0 +1,31 @@
+#!/bin/bash
+set -eu
+set -o pipefail
+
+if [ ! -d $k4MarlinWrapper_tests_DIR/inputFiles/ ]; then
+  mkdir $k4MarlinWrapper_tests_DIR/inputFiles
+fi
+
+if [ ! -f $k4MarlinWrapper_tests_DIR/inputFiles/muons.slcio ]; then
+  wget https://github.com/AIDASoft/DD4hep/raw/master/DDTest/inputFiles/muons.slcio -P $k4MarlinWrapper_tests_DIR/inputFiles/
+fi
+
+SPLITS=$k4MarlinWrapper_tests_DIR/gaudi_opts/test_event_splits.py
+
+# the run and event numbers of the processed events, in the order they were processed
+events() {
+  grep -o "Recorded run [0-9]* event [0-9]*"
+}
+
+# every event of the input, read in order by a single process
+../run gaudirun.py $SPLITS | events > shards_all.txt
+test -s shards_all.txt
+
+../run gaudirun.py $SPLITS --option "from Configurables import LcioEvent; LcioEvent().ShardCount = 2; LcioEvent().ShardIndex = 0" | events > shards_shard0.txt
+../run gaudirun.py $SPLITS --option "from Configurables import LcioEvent; LcioEvent().ShardCount = 2; LcioEvent().ShardIndex = 1" | events > shards_shard1.txt
+
+# the shards are consecutive halves of the input
+test -s shards_shard0.txt
+test -s shards_shard1.txt
+cat shards_shard0.txt shards_shard1.txt | diff shards_all.txt -
+echo "The shards processed $(wc -l < shards_shard0.txt) and $(wc -l < shards_shard1.txt) of the $(wc -l < shards_all.txt) events"
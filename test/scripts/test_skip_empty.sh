@@ -0,0 +1,33 @@
+#!/bin/bash
+set -eu
+set -o pipefail
+
+if [ ! -d $k4MarlinWrapper_tests_DIR/inputFiles/ ]; then
+  mkdir $k4MarlinWrapper_tests_DIR/inputFiles
+fi
+
+if [ ! -f $k4MarlinWrapper_tests_DIR/inputFiles/muons.slcio ]; then
+  wget https://github.com/AIDASoft/DD4hep/raw/master/DDTest/inputFiles/muons.slcio -P $k4MarlinWrapper_tests_DIR/inputFiles/
+fi
+
+export MARLIN_DLL=${MARLIN_DLL:+$MARLIN_DLL:}$TestActionProcessor_LIB
+
+# the run and event numbers of the events a processor was called for, in order
+processed() {
+  grep -o "$1 processed run [0-9]* event [0-9]*" $2 | sed "s/^$1 processed //" || true
+}
+
+../run gaudirun.py $k4MarlinWrapper_tests_DIR/gaudi_opts/test_skip_empty.py > skip_empty.log
+
+processed Maker skip_empty.log > skip_empty_maker.txt
+test $(wc -l < skip_empty_maker.txt) -eq 5
+
+# processEvent is never called when all inputs are empty or missing
+test -z "$(processed EmptyInput skip_empty.log)"
+test -z "$(processed MissingInput skip_empty.log)"
+grep -q "EmptyInput was skipped in 5 events with empty or missing inputs" skip_empty.log
+grep -q "MissingInput was skipped in 5 events with empty or missing inputs" skip_empty.log
+
+# one input with a hit is enough
+processed MixedInput skip_empty.log | diff skip_empty_maker.txt -
+echo "The processors with empty or missing inputs were skipped in all $(wc -l < skip_empty_maker.txt) events"
@@ -0,0 +1,32 @@
+#!/bin/bash
+set -eu
+set -o pipefail
+
+if [ ! -d $k4MarlinWrapper_tests_DIR/inputFiles/ ]; then
+  mkdir $k4MarlinWrapper_tests_DIR/inputFiles
+fi
+
+if [ ! -f $k4MarlinWrapper_tests_DIR/inputFiles/muons.slcio ]; then
+  wget https://github.com/AIDASoft/DD4hep/raw/master/DDTest/inputFiles/muons.slcio -P $k4MarlinWrapper_tests_DIR/inputFiles/
+fi
+
+export MARLIN_DLL=${MARLIN_DLL:+$MARLIN_DLL:}$TestActionProcessor_LIB
+
+# the run and event numbers of the events a processor was called for, in order
+processed() {
+  grep -o "$1 processed run [0-9]* event [0-9]*" $2 | sed "s/^$1 processed //" || true
+}
+
+../run gaudirun.py $k4MarlinWrapper_tests_DIR/gaudi_opts/test_skip_events.py > skip_events.log
+
+# the skipper stops the job in its fifth event
+processed Skipper skip_events.log > skip_events_skipper.txt
+test $(wc -l < skip_events_skipper.txt) -eq 5
+
+# only the first and third event passed the skipper, in the other ones the processors after it are
+# skipped and its filter is false, so that the sequencer does not run the recorder
+sed -n '1p;3p' skip_events_skipper.txt > skip_events_passed.txt
+processed After skip_events.log | diff skip_events_passed.txt -
+grep -o "Recorded run [0-9]* event [0-9]*" skip_events.log | sed "s/^Recorded //" | diff skip_events_passed.txt -
+grep -q "Skipper skipped the rest of the processors in 2 events" skip_events.log
+echo "The processors after the skipper ran in $(wc -l < skip_events_passed.txt) of $(wc -l < skip_events_skipper.txt) events"
@@ -0,0 +1,31 @@
+#!/bin/bash
+set -eu
+set -o pipefail
+
+if [ ! -d $k4MarlinWrapper_tests_DIR/inputFiles/ ]; then
+  mkdir $k4MarlinWrapper_tests_DIR/inputFiles
+fi
+
+if [ ! -f $k4MarlinWrapper_tests_DIR/inputFiles/muons.slcio ]; then
+  wget https://github.com/AIDASoft/DD4hep/raw/master/DDTest/inputFiles/muons.slcio -P $k4MarlinWrapper_tests_DIR/inputFiles/
+fi
+
+export MARLIN_DLL=${MARLIN_DLL:+$MARLIN_DLL:}$TestActionProcessor_LIB
+
+# the run and event numbers of the events a processor was called for, in order
+processed() {
+  grep -o "$1 processed run [0-9]* event [0-9]*" $2 | sed "s/^$1 processed //" || true
+}
+
+rm -f time_budget_events.txt
+../run gaudirun.py $k4MarlinWrapper_tests_DIR/gaudi_opts/test_time_budget.py > time_budget.log
+
+processed Slow time_budget.log > time_budget_slow.txt
+test $(wc -l < time_budget_slow.txt) -eq 5
+
+# the second and fourth event went over the budget: they are listed in the OverBudgetFile, as
+# "run event # processor ...", and the processors after the slow one are skipped in them
+sed -n '2p;4p' time_budget_slow.txt > time_budget_over.txt
+grep -v "^#" time_budget_events.txt | awk '{print "run " $1 " event " $2 " " $4}' | diff - <(sed 's/$/ Slow/' time_budget_over.txt)
+sed -n '1p;3p;5p' time_budget_slow.txt | diff - <(processed After time_budget.log)
+echo "$(wc -l < time_budget_over.txt) of $(wc -l < time_budget_slow.txt) events went over the budget and were skipped"
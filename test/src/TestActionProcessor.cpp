@@ -0,0 +1,139 @@
+#include <marlin/Exceptions.h>
+#include <marlin/Processor.h>
+
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <EVENT/LCEvent.h>
+#include <EVENT/LCIO.h>
+#include <EVENT/LCRunHeader.h>
+#include <IMPL/CalorimeterHitImpl.h>
+#include <IMPL/LCCollectionVec.h>
+#include <IMPL/LCEventImpl.h>
+#include <IMPL/LCRunHeaderImpl.h>
+#include <IO/LCWriter.h>
+#include <IOIMPL/LCFactory.h>
+
+#include "streamlog/streamlog.h"
+
+#include "k4MarlinWrapper/util/RunCache.h"
+
+
+// Marlin processor printing every event it processes and throwing the exceptions
+// Marlin processors use to skip events or stop the job, to test how the wrapper
+// handles them; the calls are counted from 1 in every process. It can also add
+// empty collections and collections with one hit, as inputs of later processors,
+// sleep in some calls to go over a time budget, print the run headers and the run
+// cache it sees, and write a copy of the events split into runs of a given length.
+// Its init is printed to standard output in one write, it may run on any thread.
+class TestActionProcessor : public marlin::Processor {
+public:
+  TestActionProcessor() : Processor("TestActionProcessor") {
+    _description = "Prints every event and skips or stops the processing as configured";
+    registerProcessorParameter("SkipEvery", "Throw SkipEventException in every n-th call, 0 for never", m_skipEvery, 0);
+    registerProcessorParameter("StopAt", "Throw StopProcessingException in this call, 0 for never", m_stopAt, 0);
+    registerProcessorParameter("SleepEvery", "Sleep for SleepMilliseconds in every n-th call, 0 for never", m_sleepEvery,
+                               0);
+    registerProcessorParameter("SleepMilliseconds", "Time to sleep in the calls of SleepEvery", m_sleepMilliseconds, 0);
+    registerProcessorParameter("EmptyCollections", "Collections added empty to every event", m_emptyCollections,
+                               std::vector<std::string>());
+    registerProcessorParameter("FilledCollections", "Collections added with one hit to every event",
+                               m_filledCollections, std::vector<std::string>());
+    registerProcessorParameter("PrintRuns", "Print the run headers and the run cache of every event", m_printRuns,
+                               false);
+    registerProcessorParameter("CopyFile", "LCIO file to write the events to, without their collections", m_copyFile,
+                               std::string());
+    registerProcessorParameter("CopyRunLength", "Events per run in CopyFile, the runs are numbered from 1, 0 to keep "
+                               "the run numbers of the input", m_copyRunLength, 0);
+  }
+
+  marlin::Processor* newProcessor() override { return new TestActionProcessor; }
+
+  void init() override {
+    std::cout << "Init of " + name() + "\n" << std::flush;
+    if (not m_copyFile.empty()) {
+      m_copyWriter.reset(IOIMPL::LCFactory::getInstance()->createLCWriter());
+      m_copyWriter->open(m_copyFile, EVENT::LCIO::WRITE_NEW);
+    }
+  }
+
+  void processRunHeader(EVENT::LCRunHeader* run) override {
+    if (m_printRuns) {
+      streamlog_out(MESSAGE) << name() << " run header of run " << run->getRunNumber() << std::endl;
+    }
+  }
+
+  void processEvent(EVENT::LCEvent* evt) override {
+    ++m_calls;
+    streamlog_out(MESSAGE) << name() << " processed run " << evt->getRunNumber() << " event " << evt->getEventNumber()
+                           << std::endl;
+    if (m_printRuns and k4MW::util::RunCache::current() != nullptr) {
+      streamlog_out(MESSAGE) << name() << " has the run cache of run " << k4MW::util::RunCache::current()->run()
+                             << std::endl;
+    } else if (m_printRuns) {
+      streamlog_out(MESSAGE) << name() << " has no run cache" << std::endl;
+    }
+    if (m_copyWriter) {
+      copy(evt);
+    }
+    for (const auto& collection : m_emptyCollections) {
+      evt->addCollection(new IMPL::LCCollectionVec(EVENT::LCIO::CALORIMETERHIT), collection);
+    }
+    for (const auto& collection : m_filledCollections) {
+      auto hits = new IMPL::LCCollectionVec(EVENT::LCIO::CALORIMETERHIT);
+      hits->addElement(new IMPL::CalorimeterHitImpl);
+      evt->addCollection(hits, collection);
+    }
+    if (m_sleepEvery > 0 and m_calls % m_sleepEvery == 0) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(m_sleepMilliseconds));
+    }
+    if (m_stopAt > 0 and m_calls == m_stopAt) {
+      throw marlin::StopProcessingException(this);
+    }
+    if (m_skipEvery > 0 and m_calls % m_skipEvery == 0) {
+      throw marlin::SkipEventException(this);
+    }
+  }
+
+  void end() override {
+    if (m_copyWriter) {
+      m_copyWriter->close();
+    }
+  }
+
+private:
+  void copy(const EVENT::LCEvent* evt) {
+    const int run = m_copyRunLength > 0 ? 1 + (m_calls - 1) / m_copyRunLength : evt->getRunNumber();
+    if (run != m_copyRun) {
+      IMPL::LCRunHeaderImpl header;
+      header.setRunNumber(run);
+      m_copyWriter->writeRunHeader(&header);
+      m_copyRun = run;
+    }
+    IMPL::LCEventImpl event;
+    event.setRunNumber(run);
+    event.setEventNumber(evt->getEventNumber());
+    m_copyWriter->writeEvent(&event);
+    streamlog_out(MESSAGE) << name() << " wrote run " << run << " event " << evt->getEventNumber() << std::endl;
+  }
+
+  int                      m_skipEvery         = 0;
+  int                      m_stopAt            = 0;
+  int                      m_sleepEvery        = 0;
+  int                      m_sleepMilliseconds = 0;
+  std::vector<std::string> m_emptyCollections{};
+  std::vector<std::string> m_filledCollections{};
+  bool                     m_printRuns     = false;
+  std::string              m_copyFile      = "";
+  int                      m_copyRunLength = 0;
+  int                      m_calls         = 0;
+
+  std::unique_ptr<IO::LCWriter> m_copyWriter;
+  int                           m_copyRun = -1;
+};
+
+TestActionProcessor aTestActionProcessor;
@@ -0,0 +1,40 @@
+#include "TestEventRecorder.h"
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include <EVENT/LCEvent.h>
+
+#include "k4MarlinWrapper/LCEventWrapper.h"
+
+DECLARE_COMPONENT(TestEventRecorder)
+
+TestEventRecorder::TestEventRecorder(const std::string& name, ISvcLocator* pSL) : GaudiAlgorithm(name, pSL) {}
+
+StatusCode TestEventRecorder::execute() {
+  DataObject* pObject = nullptr;
+  if (eventSvc()->retrieveObject("/Event/LCEvent", pObject).isFailure()) {
+    error() << "No LCEvent in the event store" << endmsg;
+    return StatusCode::FAILURE;
+  }
+  const auto* event = static_cast<LCEventWrapper*>(pObject)->getEvent();
+  info() << "Recorded run " << event->getRunNumber() << " event " << event->getEventNumber() << endmsg;
+  if (m_printCollections) {
+    std::vector<std::string> names = *event->getCollectionNames();
+    std::sort(names.begin(), names.end());
+    auto& message = info() << "Collections of run " << event->getRunNumber() << " event " << event->getEventNumber()
+                           << ":";
+    for (const auto& name : names) {
+      message << " " << name;
+    }
+    message << endmsg;
+  }
+  ++m_events;
+  return StatusCode::SUCCESS;
+}
+
+StatusCode TestEventRecorder::finalize() {
+  info() << "Recorded " << m_events << " events in this process" << endmsg;
+  return GaudiAlgorithm::finalize();
+}
@@ -0,0 +1,25 @@
+#ifndef TEST_EVENTRECORDER_H
+#define TEST_EVENTRECORDER_H
+
+#include <string>
+
+#include <GaudiAlg/GaudiAlgorithm.h>
+
+
+// Prints the run and event number of every LCEvent in the event store, for the
+// test scripts to compare the events a job processed with the expected ones,
+// and with PrintCollections the names of the collections decoded in the event
+class TestEventRecorder : public GaudiAlgorithm {
+public:
+  explicit TestEventRecorder(const std::string& name, ISvcLocator* pSL);
+  virtual ~TestEventRecorder() = default;
+  virtual StatusCode execute() override final;
+  virtual StatusCode finalize() override final;
+
+private:
+  Gaudi::Property<bool> m_printCollections{this, "PrintCollections", false,
+                                           "Print the sorted names of the collections of every event"};
+  unsigned int          m_events = 0;
+};
+
+#endif
@@ -0,0 +1,30 @@
+#include "TestReturnValues.h"
+
+#include <memory>
+
+#include "k4MarlinWrapper/ProcessorReturnValues.h"
+
+DECLARE_COMPONENT(TestReturnValues)
+
+TestReturnValues::TestReturnValues(const std::string& name, ISvcLocator* pSL) : GaudiAlgorithm(name, pSL) {}
+
+StatusCode TestReturnValues::execute() {
+  DataObject* pObject = nullptr;
+  if (eventSvc()->retrieveObject(ProcessorReturnValues::Location, pObject).isFailure()) {
+    auto       created = std::make_unique<ProcessorReturnValues>();
+    const auto sc      = eventSvc()->registerObject(ProcessorReturnValues::Location, created.get());
+    if (sc.isFailure()) {
+      error() << "Failed to store the return values" << endmsg;
+      return sc;
+    }
+    pObject = created.release();
+  }
+  auto* returnValues = static_cast<ProcessorReturnValues*>(pObject);
+  for (const auto& value : m_trueValues) {
+    returnValues->set(value, true);
+  }
+  for (const auto& value : m_falseValues) {
+    returnValues->set(value, false);
+  }
+  return StatusCode::SUCCESS;
+}
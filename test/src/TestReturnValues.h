@@ -0,0 +1,25 @@
+#ifndef TEST_RETURNVALUES_H
+#define TEST_RETURNVALUES_H
+
+#include <string>
+#include <vector>
+
+#include <GaudiAlg/GaudiAlgorithm.h>
+
+
+// Publishes the same return values in every event, like a Marlin processor
+// calling setReturnValue, to test the conditions of the processor wrappers
+class TestReturnValues : public GaudiAlgorithm {
+public:
+  explicit TestReturnValues(const std::string& name, ISvcLocator* pSL);
+  virtual ~TestReturnValues() = default;
+  virtual StatusCode execute() override final;
+
+private:
+  Gaudi::Property<std::vector<std::string>> m_trueValues{
+      this, "TrueValues", {}, "Return values set to true, by processor name or as 'processor.value'"};
+  Gaudi::Property<std::vector<std::string>> m_falseValues{
+      this, "FalseValues", {}, "Return values set to false, by processor name or as 'processor.value'"};
+};
+
+#endif
@@ -0,0 +1,26 @@
+#include <marlin/Global.h>
+#include <marlin/Processor.h>
+#include <marlin/ProcessorEventSeeder.h>
+
+#include <EVENT/LCEvent.h>
+
+#include "streamlog/streamlog.h"
+
+
+// Marlin processor printing the seed it gets from the event seeder in every event,
+// to compare the seeds of jobs that split the events differently
+class TestSeedProcessor : public marlin::Processor {
+public:
+  TestSeedProcessor() : Processor("TestSeedProcessor") { _description = "Prints the random seed of every event"; }
+
+  marlin::Processor* newProcessor() override { return new TestSeedProcessor; }
+
+  void init() override { marlin::Global::EVENTSEEDER->registerProcessor(this); }
+
+  void processEvent(EVENT::LCEvent* evt) override {
+    streamlog_out(MESSAGE) << "Seed of run " << evt->getRunNumber() << " event " << evt->getEventNumber() << ": "
+                           << marlin::Global::EVENTSEEDER->getSeed(this) << std::endl;
+  }
+};
+
+TestSeedProcessor aTestSeedProcessor;